@@ -1,28 +1,32 @@
+#define _POSIX_C_SOURCE         200809L // for ctime_r() and sysconf()
+#ifdef MYSCHEDULER_PROFILE
+#define _DEFAULT_SOURCE                 // for syscall(), to read hardware counters
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 
-#include <ctype.h>                      // for isalnum()
+#include <ctype.h>                      // for isalnum() and isalpha()
+#include <limits.h>                     // for INT_MAX and LLONG_MAX
 #include <math.h>                       // for ceil()
+#include <setjmp.h>                     // for abandoning a failed library call
+
+#include "myscheduler.h"
 
 
 
-//  THESE CONSTANTS DEFINE THE MAXIMUM SIZE OF sysconfig AND command DETAILS
-//  THAT YOUR PROGRAM NEEDS TO SUPPORT.  YOU'LL REQUIRE THESE CONSTANTS
-//  WHEN DEFINING THE MAXIMUM SIZES OF ANY REQUIRED DATA STRUCTURES.
+//  THIS CONSTANT DEFINES THE MAXIMUM NUMBER OF RUNNING PROCESSES.
+//  THE NUMBER OF DEVICES, COMMANDS, AND SYSCALLS PER COMMAND, AND THE LENGTH
+//  OF THEIR NAMES, IS LIMITED ONLY BY MEMORY - THEIR TABLES GROW AS THE
+//  INPUT FILES ARE READ.
 
-#define MAX_DEVICES                     4
-#define MAX_DEVICE_NAME                 20
-#define MAX_COMMANDS                    10
-#define MAX_COMMAND_NAME                20
-#define MAX_SYSCALLS_PER_PROCESS        40
-#define MAX_RUNNING_PROCESSES           50
+#define MAX_RUNNING_PROCESSES           1000000
 
 //  NOTE THAT DEVICE DATA-TRANSFER-RATES ARE MEASURED IN BYTES/SECOND,
-//  THAT ALL TIMES ARE MEASURED IN MICROSECONDS (usecs),
-//  AND THAT THE TOTAL-PROCESS-COMPLETION-TIME WILL NOT EXCEED 2000 SECONDS
-//  (SO YOU CAN SAFELY USE 'STANDARD' 32-BIT ints TO STORE TIMES).
+//  AND THAT ALL TIMES ARE MEASURED IN MICROSECONDS (usecs).
+//  TIMES ARE STORED IN 64-BIT INTEGERS (usecs_t), SO SIMULATIONS MAY RUN FOR HOURS.
 
 #define DEFAULT_TIME_QUANTUM            100
 
@@ -32,7 +36,6 @@
 
 //  ----------------------------------------------------------------------
 
-#define MAX_WORD                        20
 #define UNKNOWN                         (-1)
 
 #define STATE_READY                     0
@@ -41,851 +44,7004 @@
 #define STATE_WAITING                   3
 #define STATE_IO_BLOCKED                4
 #define STATE_TERMINATED                5
+#define STATE_NEW                       6       // until first READY
 
-//  DECLARE (NOT DEFINE) FUNCTIONS THAT ARE CALLED BEFORE BEING DEFINED
-void DEBUG(char *fmt, ...);
-void flush_DEBUG(int proc_on_CPU);
-
-void append_to_READY_queue(int proc, char came_from[]);
-int  find_device_byname(char name[]);
+//  ----------------------------------------------------------------------
 
-int USECS_SINCE_REBOOT      = 0;        // the global clock
-int timequantum             = DEFAULT_TIME_QUANTUM;
+//  EACH EVENT OF A TRACED SIMULATION IS RECORDED IN A FIXED-SIZE BINARY
+//  RECORD, RATHER THAN BEING FORMATTED AS TEXT WHILE THE SIMULATION RUNS.
+//  A RECORD EITHER ADDS A PHRASE TO THE CURRENT LINE OF THE TEXT TRACE, OR
+//  (EVENT_FLUSH) ENDS THAT LINE.  THE TICKS SKIPPED BY A CORE, EACH OF WHICH
+//  WOULD PRINT A "c" OR "idle" LINE, ARE RECORDED AS A SINGLE SPAN, AND EACH
+//  TRANSITION AS A SINGLE RECORD, HOWEVER MANY "+" LINES IT WOULD PRINT.
+
+#define EVENT_FLUSH             0       // which=command or UNKNOWN, arg0=onCPU
+#define EVENT_REBOOT            1       // arg0=real-world time, arg1=timequantum
+#define EVENT_SPAWN             2       // which=command
+#define EVENT_READY             3       // which=state it came from
+#define EVENT_NO_TRANSITION     4
+#define EVENT_TRANSITION        5       // arg0=usecs
+#define EVENT_EXIT              6
+#define EVENT_BLOCKED           7       // which=syscall, arg0=nbytes
+#define EVENT_IO_COMPLETE       8       // which=device, arg0=syscall
+#define EVENT_DATABUS_IDLE      9       // which=bus
+#define EVENT_ACQUIRE_BUS       10      // which=device, arg0=syscall, arg1=nbytes, arg2=usecs
+#define EVENT_STOLEN            11      // which=victim core
+#define EVENT_RUNNING           12
+#define EVENT_ON_CPU            13
+#define EVENT_WAITING           14
+#define EVENT_WAIT_NO_CHILDREN  15
+#define EVENT_SLEEPING          16      // arg0=usecs
+#define EVENT_TQ_EXPIRED        17
+#define EVENT_COMPUTE           18      // which=command
+#define EVENT_IDLE              19
+#define EVENT_SHUTDOWN          20
+#define EVENT_SUMMARY           21      // arg0=usecs onCPU, arg1=utilization
+#define EVENT_COMPUTE_SPAN      22      // which=command, arg0=until, arg1=first onCPU
+#define EVENT_IDLE_SPAN         23      // arg0=until
+#define EVENT_COALESCED         24      // which=device, arg0=syscall, arg1=nbytes, arg2=usecs
+
+//  ONLY A TRACED SIMULATION RECORDS EVENTS, AND ONLY THEN ARE THEIR ARGUMENTS EVALUATED
+#define TRACE(sim, ...)     do { if((sim)->tracer != NULL) trace_event(sim, __VA_ARGS__); } while(0)
 
-bool verbose                = true;     // if debug printing required
+//  ----------------------------------------------------------------------
 
-void advance_time(int inc)
-{
-    if(inc > 1 && verbose) {
-        DEBUG("transition takes %iusecs (%i..%i)", inc, USECS_SINCE_REBOOT+1, USECS_SINCE_REBOOT+inc);
-        flush_DEBUG(UNKNOWN);
+//  WHEN COMPILED WITH -DMYSCHEDULER_PROFILE, THE SIMULATOR PROFILES ITSELF.
+//  EACH PHASE OF READING AND EXECUTING A WORKLOAD COUNTS ITS CALLS, THE
+//  ELEMENTS THAT IT EXAMINES OR MOVES, AND THE TICKS (OF THE CPU'S TIMESTAMP
+//  COUNTER, IF IT HAS ONE) THAT IT TAKES.  PHASES NEST, SO EACH ONE'S TICKS
+//  INCLUDE THOSE OF THE PHASES THAT IT CALLS.  OTHERWISE, THE PROFILE MACROS
+//  COMPILE TO NOTHING, AND NOTHING IS MEASURED.
+
+#define PHASE_PARSE             0       // elements=bytes read
+#define PHASE_STEP              1       // all of ms_step(), elements=events
+#define PHASE_SELECT            2       // elements=cores examined
+#define PHASE_SKIP              3       // elements=uneventful ticks skipped
+#define PHASE_SYSCALL           4
+#define PHASE_READY             5       // elements=processes enqueued or dequeued
+#define PHASE_SLEEPING          6       // elements=sleepers awakened
+#define PHASE_WAITING           7       // elements=waiting processes examined
+#define PHASE_IO_COMPLETE       8       // elements=buses examined
+#define PHASE_IO_START          9       // elements=transfers started
+#define PHASE_ARRIVALS          10      // elements=arrivals read
+#define PHASE_TRACE             11      // elements=records
+#define NPHASES                 12
+
+char *phase_names[] = {
+    "parse", "step", "select", "skip", "syscall", "ready",
+    "sleeping", "waiting", "io_complete", "io_start", "arrivals", "trace", NULL
+};
 
-        for(int t=0 ; t < inc ; ++t) {
-            USECS_SINCE_REBOOT += 1;
-            DEBUG("+");
-            flush_DEBUG(UNKNOWN);
-        }
-    }
-    else {
-        USECS_SINCE_REBOOT += inc;
-    }
-}
+//  THE LINUX HARDWARE COUNTERS, IF AVAILABLE, COUNT THROUGHOUT EACH ms_step()
+#define HW_CYCLES               0
+#define HW_INSTRUCTIONS         1
+#define HW_CACHE_MISSES         2
+#define HW_BRANCH_MISSES        3
+#define NHW_COUNTERS            4
 
-//  ----------------------------------------------------------------------
+char *hw_counter_names[] = {
+    "cycles", "instructions", "cache_misses", "branch_misses", NULL
+};
 
-#define SYS_SPAWN                       0
-#define SYS_READ                        1
-#define SYS_WRITE                       2
-#define SYS_SLEEP                       3
-#define SYS_WAIT                        4
-#define SYS_EXIT                        5
+struct phase {
+    long long           ncalls;
+    long long           nelements;
+    unsigned long long  ticks;
+};
 
-char *syscalls[] = {
-    "spawn", "read", "write", "sleep", "wait", "exit", NULL
+struct profile {
+    struct phase        phases[NPHASES];
+    long long           step_nsecs;     // real-world time within ms_step()
+    long long           step_began;     // in nsecs, of the current ms_step()
+    bool                hw_opened;
+    int                 hw_fd[NHW_COUNTERS];    // or UNKNOWN if unavailable
 };
 
-int find_syscall_byname(char name[])
+#ifdef MYSCHEDULER_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define profile_clock()             __rdtsc()
+#else
+#include <time.h>
+static inline unsigned long long profile_clock(void)
 {
-    for(int s=0 ; syscalls[s] != NULL ; ++s) {
-        if(strcmp(syscalls[s], name) == 0) {
-            return s;
-        }
-    }
-    printf("ERROR - syscall '%s' not found\n", name);
-    exit(EXIT_FAILURE);
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec*1000000000ULL + now.tv_nsec;
 }
+#endif
+
+#define PROFILE_BEGIN()             unsigned long long profile_began = profile_clock()
+#define PROFILE_END(prof, ph)       do { (prof)->phases[ph].ticks += profile_clock() - profile_began; \
+                                         ++(prof)->phases[ph].ncalls; } while(0)
+#define PROFILE_COUNT(prof, ph, n)  ((prof)->phases[ph].nelements += (n))
+#else
+#define PROFILE_BEGIN()
+#define PROFILE_END(prof, ph)
+#define PROFILE_COUNT(prof, ph, n)
+#endif
 
 //  ----------------------------------------------------------------------
 
-//  AN ARRAY OF STRUCTURES AND FUNCTIONS TO MANAGE THE SYSTEM'S KNOWN COMMANDS
+//  ALL STATE IS HELD IN TWO CONTEXTS, SO THAT ANY NUMBER OF SIMULATIONS MAY
+//  RUN AT ONCE.  A workload HOLDS THE SYSTEM'S DEVICES AND COMMANDS, READ FROM
+//  THE sysconfig AND command FILES, AND IS NEVER MODIFIED AFTER THEY'RE READ.
+//  A simulation HOLDS EVERYTHING THAT CHANGES AS ITS PROCESSES EXECUTE.
+//  THE TABLES THAT THEY POINT TO ARE DESCRIBED IN THE SECTIONS BELOW.
+
+//  AN ERROR ABANDONS THE CURRENT LIBRARY CALL, WHICH REPORTS THE message
+struct failure {
+    jmp_buf     on_error;
+    char        message[BUFSIZ];
+};
 
-struct {
-    char        name[MAX_COMMAND_NAME+1];
-    struct {
-        int     when;                           // usecs of onCPU time
-        int     which;                          // which system-call
-        int     arg0;
-        int     arg1;
-        char    cmdname[MAX_COMMAND_NAME+1];    // iff spawn
-    } syscalls[MAX_SYSCALLS_PER_PROCESS];
-    int         nsyscalls;
-} commands[MAX_COMMANDS];
+struct scanner {                        // see SCANNING INPUT FILES, below
+    const char  *filename;
+    char        *map;                   // the whole file
+    size_t      size;
+    bool        mapped;                 // else map was malloc()ed
+    long long   mtime;                  // when it was last modified
+    const char  *p, *end;               // the next character, and the end
+    const char  *line_start;
+    int         lc;                     // the current line's number
+};
 
-int ncommands               = 0;
-#define FOREACH_COMMAND     for(int c=0 ; c<ncommands ; ++c)
+struct queue {                          // see FIFO QUEUE OF PROCESSES, below
+    int         head, tail;             // indices into processes[]
+    int         n;
+};
 
-void add_command(char line[])
-{
-    if(sscanf(line, "%s", commands[ncommands].name) == 1) {
-        commands[ncommands].nsyscalls       = 0;
-        ++ncommands;
-    }
-}
+struct workload {
+    struct symbol   *symbols;
+    int             nsymbols;
+    int             symbols_capacity;
+
+    char            *symbol_names;      // all names, each NUL-terminated
+    int             symbol_names_size;
+    int             symbol_names_capacity;
+
+    int             *symbol_hash;       // indices into symbols[], or UNKNOWN
+    int             symbol_hash_size;   // always a power of 2
+
+    struct command  *commands;
+    int             ncommands;
+    int             commands_capacity;
+
+//  THE SYSCALLS OF ALL COMMANDS, STORED CONTIGUOUSLY IN THE ORDER THEY'RE READ
+    struct syscall  *all_syscalls;
+    int             nall_syscalls;
+    int             all_syscalls_capacity;
+
+//  THE DISTRIBUTIONS OF STOCHASTIC SYSCALLS, AND ALL OF THEIR PARAMETERS
+    struct distribution *distributions;
+    int             ndistributions;
+    int             distributions_capacity;
+    long long       *distribution_params;
+    int             ndistribution_params;
+    int             distribution_params_capacity;
+
+    struct device   *devices;
+    int             ndevices;
+    int             devices_capacity;
+
+    struct ms_config    config;         // as read from sysconfig
+
+    FILE            *warnings;          // or NULL if not reported
+    struct scanner  in;                 // the file being read
+    struct scanner  image;              // the mapped image holding the tables, if any
+
+//  THE command FILE (FROM WHICH AN IMAGE IS COMPILED)
+    char            *source_name;
+    unsigned long long  source_hash;
+    long long       source_size;
+    long long       source_mtime;
+    bool            failed;
+    struct failure  failure;
+#ifdef MYSCHEDULER_PROFILE
+    struct profile  profile;            // of PHASE_PARSE only
+#endif
+};
+
+struct simulation {
+    const struct workload   *w;
+
+    usecs_t         USECS_SINCE_REBOOT; // this simulation's clock
+    usecs_t         timequantum;
+    int             ncores;
+    int             steal_policy;
+    usecs_t         time_steal;
+    struct tracer   *tracer;            // or NULL if not traced
+    struct telemetry    *telemetry;     // or NULL if not published
+    FILE            *trace;             // where the trace goes
+    int             trace_format;
+
+    unsigned long long  seed;           // of its processes' random streams
+
+    bool            started, finished, failed;
+    usecs_t         total_time_on_CPU;  // by all exited processes
+    long long       nevents;
+
+    struct process  *processes;
+    int             nprocesses;         // #running processes
+    int             nslots;             // #slots ever used
+    int             processes_capacity;
+    struct history  *histories;         // parallel to processes[]
+    int             histories_capacity;
+    int             first_free_slot;
+    long long       next_pid;           // never reused
+    long long       nspawned;           // #processes ever spawned
+
+    struct queue    *IO_BLOCKED_queues; // one per device
+    struct bus      *buses;
+    int             nbuses;
+    int             arbitration;
+    int             nblocked;           // #blocked in all I/O queues
+    int             coalesce_count;     // see coalesce_batch(), or 0
+    long long       coalesce_bytes;
+    long long       ncoalesced;         // #requests not acquiring the bus
+
+    struct core     *cores;
+    int             cores_capacity;
+    int             current_core;       // the core executing now
+    int             nready;             // #ready in all READY queues
+    const struct scheduler  *scheduler;
+    long long       nenqueued;          // order in which processes became READY
+
+    bool            indexed;            // see INDEXING THE CORES, below
+    struct keyed    *busy_cores;        // a heap of cores, by next eventful usec
+    int             nbusy;
+    int             busy_cores_capacity;
+    int             *idle_cores;
+    int             *idle_index;        // of each idle core in idle_cores[]
+    int             nidle;
+    int             idle_capacity;
+    usecs_t         frontier_usec;      // of the last event
+    int             frontier_core;
+
+    struct queue    WAITING_queue;
+    struct keyed    *childless;         // WAITING whose children have exited
+    int             nwaiting_childless;
+    int             childless_capacity;
+    long long       nwaits;             // order in which processes began WAITING
+
+    struct sleeper  *SLEEPING_queue;
+    int             nsleeping;
+    int             SLEEPING_queue_capacity;
+    long long       nsleeps;
+
+    struct sleeper  *awakening;         // sleepers awakened together
+    int             awakening_capacity;
+
+    struct histogram    *metrics;       // MS_NMETRICS of them
+    struct histogram    *device_metrics;// MS_NDEVICE_METRICS per device
+
+    FILE            *arrivals;          // of an open system, or NULL
+    char            *arrival_line;      // the record last read
+    size_t          arrival_line_size;
+    long long       arrivals_lc;
+    usecs_t         next_arrival;       // or LLONG_MAX if none
+    int             next_arrival_command;
+    long long       narrived;           // #processes that have arrived
+
+    struct failure  failure;
+#ifdef MYSCHEDULER_PROFILE
+    struct profile  profile;
+#endif
+};
 
-int find_command_byname(char name[])
+//  DECLARE (NOT DEFINE) FUNCTIONS THAT ARE CALLED BEFORE BEING DEFINED
+void fail(struct failure *f, char *fmt, ...);
+void trace_event(struct simulation *sim, int event, long long pid, int which,
+                 long long arg0, long long arg1, long long arg2);
+void trace_flush(struct simulation *sim, int proc_on_CPU);
+void trace_span(struct simulation *sim, int core, usecs_t from, usecs_t until);
+void print_DEBUG_line(FILE *fp, usecs_t usecs, int ncores, int core,
+                      char text[], const char name[], char oncpu[]);
+
+void append_to_READY_queue(struct simulation *sim, int proc, int came_from);
+int  find_device_byname(const struct workload *w, const char name[], int length);
+void child_has_exited(struct simulation *sim, int parent);
+
+void advance_time(struct simulation *sim, usecs_t inc)
 {
-    FOREACH_COMMAND {
-        if(strcmp(commands[c].name, name) == 0) {
-            return c;
-        }
+    if(inc > 1) {
+        TRACE(sim, EVENT_TRANSITION, UNKNOWN, UNKNOWN, inc, 0, 0);
     }
-    printf("ERROR - command '%s' not found\n", name);
-    exit(EXIT_FAILURE);
+    sim->USECS_SINCE_REBOOT += inc;
 }
 
-void add_syscall_to_command(char line[])
-{
-    int c = ncommands-1;
-    int s = commands[c].nsyscalls;
-
-    char usecs[MAX_WORD], word1[MAX_WORD], word2[MAX_WORD], word3[MAX_WORD];
-    sscanf(line, "%s %s %s %s", usecs, word1, word2, word3);
-
-    commands[c].syscalls[s].when    = atoi(usecs);
-    commands[c].syscalls[s].which   = find_syscall_byname(word1);
-
-    switch (commands[c].syscalls[s].which) {
-        case SYS_SPAWN:
-            strcpy(commands[c].syscalls[s].cmdname, word2);
-            break;
-
-        case SYS_READ:
-        case SYS_WRITE:
-            commands[c].syscalls[s].arg0    = find_device_byname(word2);
-            commands[c].syscalls[s].arg1    = atoi(word3);
-            break;
-
-        case SYS_SLEEP:
-            commands[c].syscalls[s].arg0    = atoi(word2);
-            break;
+//  ----------------------------------------------------------------------
 
-        case SYS_WAIT:
-        case SYS_EXIT:
-            break;
-    }
-    ++commands[c].nsyscalls;
-}
+//  THE TABLES OF DEVICES, COMMANDS, AND SYSCALLS ARE EACH HELD IN A SINGLE
+//  CONTIGUOUS ALLOCATION, WHOSE CAPACITY DOUBLES WHENEVER IT BECOMES FULL.
+//  SO, READING n ENTRIES COPIES ONLY O(n) ENTRIES IN TOTAL.
+//  A TABLE NEVER HOLDS MORE THAN INT_MAX BYTES, SO ITS int CAPACITY
+//  (AND ANY INDEX INTO IT) CANNOT OVERFLOW.
 
-//  FIND COMMAND-NAMES FOR SYS_SPAWN, ENSURE A CALL TO SYS_EXIT
-void patch_commands(void)
+void *grow_table(struct failure *f, void *table, int *capacity, int needed, size_t size)
 {
-    FOREACH_COMMAND {
-        bool exit_found = false;
-        for(int s=0 ; s<commands[c].nsyscalls ; ++s) {
-            if(commands[c].syscalls[s].which == SYS_SPAWN) {
-                commands[c].syscalls[s].arg0    = find_command_byname(commands[c].syscalls[s].cmdname);
-            }
-            else if(commands[c].syscalls[s].which == SYS_EXIT) {
-                exit_found  = true;
-            }
+    if(needed > *capacity) {
+        int maxcapacity = (int)(INT_MAX / size);
+        int newcapacity = (*capacity == 0) ? 16 : *capacity;
+
+        if(needed > maxcapacity) {
+            fail(f, "ERROR - too many entries (%i) for a table of at most %i", needed, maxcapacity);
+        }
+        while(newcapacity < needed) {
+            newcapacity = (newcapacity > maxcapacity / 2) ? maxcapacity : newcapacity * 2;
         }
-        if(!exit_found) {
-            DEBUG("WARNING - command '%s' never calls 'exit'", commands[c].name);
-            flush_DEBUG(UNKNOWN);
+        void *newtable  = realloc(table, newcapacity * size);
+        if(newtable == NULL) {
+            fail(f, "ERROR - out of memory for %i table entries", newcapacity);
         }
+        table       = newtable;
+        *capacity   = newcapacity;
     }
+    return table;
 }
 
 //  ----------------------------------------------------------------------
 
-//  AN ARRAY OF STRUCTURES AND FUNCTIONS TO MANAGE THE SYSTEM'S PROCESSES
+//  A HISTOGRAM OF usecs, IN THE STYLE OF AN HDR HISTOGRAM.  VALUES BELOW
+//  HISTOGRAM_SUB EACH HAVE THEIR OWN BUCKET.  LARGER VALUES ARE BUCKETED BY
+//  THEIR POWER OF 2, EACH POWER BEING SPLIT INTO HISTOGRAM_SUB LINEAR
+//  SUB-BUCKETS, SO EVERY BUCKET IS WITHIN 1/HISTOGRAM_SUB OF ITS VALUES.
 
-struct {
-    int         state;                  // STATE_READY, STATE_RUNNING ...
-    int         pid, ppid;
-    int         time_on_CPU;
-    int         command;                // index into commands[]
-    int         next_syscall;           // index into commands[c].syscalls[]
-    int         nchildren;              // other processes invoked by 'spawn'
-} processes[MAX_RUNNING_PROCESSES];
+#define HISTOGRAM_SUB_BITS      5
+#define HISTOGRAM_SUB           (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_NBUCKETS      ((64-HISTOGRAM_SUB_BITS) * HISTOGRAM_SUB)
 
-int nprocesses              = 0;
-#define FOREACH_PROCESS         for(int p=0 ; p<MAX_RUNNING_PROCESSES ; ++p)
-#define PROCESS_SLOT_UNUSED(p)  (processes[p].pid == UNKNOWN)
+struct histogram {
+    long long   count;
+    usecs_t     min, max;
+    usecs_t     total;
+    long long   buckets[HISTOGRAM_NBUCKETS];
+};
 
-void init_processes(void)
+int histogram_bucket(usecs_t value)
 {
-    FOREACH_PROCESS {
-        processes[p].pid    = UNKNOWN;  // => unused slot
+    if(value < HISTOGRAM_SUB) {
+        return (value < 0) ? 0 : value;
     }
-    nprocesses      = 0;
+    int e   = 63 - __builtin_clzll(value);      // value's highest bit
+
+    return (e-HISTOGRAM_SUB_BITS+1)*HISTOGRAM_SUB + ((value >> (e-HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB-1));
 }
 
-//  SPAWN THE REQUESTED COMMAND, ADD TO THE READY QUEUE, ADD PARENT TO READY
-void spawn_process(int command, int ppid)
-{
-    FOREACH_PROCESS {
-        if(PROCESS_SLOT_UNUSED(p)) {
-            static int next_pid             = 0;
-
-            processes[p].state              = STATE_READY;
-            processes[p].pid                = next_pid++;
-            processes[p].ppid               = ppid;
-            processes[p].command            = command;
-            processes[p].next_syscall       = 0;
-            processes[p].time_on_CPU        = 0;
-
-            processes[p].nchildren          = 0;
-            ++nprocesses;
-
-            DEBUG("spawn '%s'", commands[command].name);
-            append_to_READY_queue(p, "NEW");
-            DEBUG("transition takes 0usecs");
-            flush_DEBUG(UNKNOWN);
-            return;
-        }
+//  THE HIGHEST VALUE THAT IS COUNTED IN THE GIVEN BUCKET
+usecs_t histogram_bucket_max(int b)
+{
+    if(b < HISTOGRAM_SUB) {
+        return b;
     }
-    printf("ERROR - process limit of %i exceeded\n", MAX_RUNNING_PROCESSES);
-    exit(EXIT_FAILURE);
+    int shift   = b/HISTOGRAM_SUB - 1;
+
+    return ((usecs_t)(HISTOGRAM_SUB + b%HISTOGRAM_SUB) << shift) + ((usecs_t)1 << shift) - 1;
 }
 
-void exit_process(int proc_on_CPU)
+void histogram_record(struct histogram *h, usecs_t value)
 {
-    DEBUG("exit, pid%i.RUNNING->EXIT", processes[proc_on_CPU].pid);
-    DEBUG("transition takes 0usecs");
-    flush_DEBUG(processes[proc_on_CPU].command);
+    if(h->count == 0 || value < h->min) {
+        h->min  = value;
+    }
+    if(h->count == 0 || value > h->max) {
+        h->max  = value;
+    }
+    ++h->count;
+    h->total    += value;
+    ++h->buckets[histogram_bucket(value)];
+}
 
-    FOREACH_PROCESS {
-        if(PROCESS_SLOT_UNUSED(p)) {
-            continue;
-        }
-        if(processes[p].pid == processes[proc_on_CPU].ppid) {   // found parent
-            --processes[p].nchildren;
-            break;                                              // as only one
+//  THE VALUE BELOW WHICH THE GIVEN percent OF ALL RECORDED VALUES FALL
+usecs_t histogram_percentile(const struct histogram *h, double percent)
+{
+    long long   rank    = ceil(percent/100.0 * h->count);
+    long long   seen    = 0;
+
+    if(rank < 1) {
+        rank    = 1;
+    }
+    for(int b=0 ; b<HISTOGRAM_NBUCKETS ; ++b) {
+        seen    += h->buckets[b];
+        if(seen >= rank) {
+            usecs_t value   = histogram_bucket_max(b);
+
+            return (value < h->min) ? h->min : (value > h->max) ? h->max : value;
         }
     }
-    processes[proc_on_CPU].pid     = UNKNOWN;                   // now unused
-    processes[proc_on_CPU].state   = STATE_TERMINATED;
-    --nprocesses;
+    return h->max;
 }
 
 //  ----------------------------------------------------------------------
 
-//  AN ARRAY OF STRUCTURES AND FUNCTIONS TO MANAGE THE SYSTEM'S I/O DEVICES
-
-struct {
-    char        name[MAX_DEVICE_NAME+1];
-    int         read_speed;                 // Bps
-    int         write_speed;                // Bps
-
-    struct {
-        int     proc;                       // index into processes[]
-        int     syscall;                    // SYS_READ or SYS_WRITE
-        int     nbytes;                     // size of request
-    } blocked[MAX_RUNNING_PROCESSES];
-    int         nblocked;
+#define SYS_SPAWN                       0
+#define SYS_READ                        1
+#define SYS_WRITE                       2
+#define SYS_SLEEP                       3
+#define SYS_WAIT                        4
+#define SYS_EXIT                        5
 
-} devices[MAX_DEVICES];
+char *syscalls[] = {
+    "spawn", "read", "write", "sleep", "wait", "exit", NULL
+};
 
-int ndevices                = 0;
-#define FOREACH_DEVICE      for(int d=0 ; d<ndevices ; ++d)
+//  ----------------------------------------------------------------------
 
-//  WHICH DEVICE CURRENTLY OWNS THE DATA-BUS AND IS BLOCKED?
-int device_owning_databus   = UNKNOWN;
-int databus_inuse_until     = UNKNOWN;
-int nblocked                = 0;            // #blocked in all I/O queues
+//  THE sysconfig AND command FILES ARE MEMORY-MAPPED (OR, IF THEY CANNOT BE,
+//  READ WHOLE) AND SCANNED IN PLACE.  NAMES ARE INTERNED STRAIGHT FROM THE
+//  MAPPING, AND NUMBERS ARE CONVERTED AS THEY'RE SCANNED, SO NOTHING IS
+//  COPIED AND NO WORD IS TOO LONG.  ERRORS REPORT THEIR LINE AND COLUMN.
 
-void init_devices_and_IO_BLOCKED_queues(void)
-{
-    FOREACH_DEVICE {
-        devices[d].nblocked = 0;
-    }
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-    device_owning_databus   = UNKNOWN;
-    databus_inuse_until     = UNKNOWN;
-    nblocked                = 0;
-}
+#define CHAR_COMMENT            '#'
 
-void add_device(char name[], int read_speed, int write_speed)
+void open_scanner(struct failure *f, struct scanner *in, const char filename[])
 {
-    strcpy(devices[ndevices].name, name);
-    devices[ndevices].read_speed    = read_speed;
-    devices[ndevices].write_speed   = write_speed;
-    ++ndevices;
-}
+    memset(in, 0, sizeof *in);
+    in->filename    = filename;
 
-void append_to_IO_BLOCKED_queue(int proc_on_CPU, int syscall, int device, int nbytes)
-{
-    DEBUG("%s %ibytes, pid%i.RUNNING->BLOCKED", syscalls[syscall], nbytes, processes[proc_on_CPU].pid);
-    advance_time(TIME_CORE_STATE_TRANSITIONS);
+    int fd  = open(filename, O_RDONLY);
+    struct stat st;
 
-    int nb  = devices[device].nblocked;
+    if(fd < 0 || fstat(fd, &st) != 0) {
+        if(fd >= 0) {
+            close(fd);
+        }
+        fail(f, "ERROR - cannot open '%s'", filename);
+    }
 
-    devices[device].blocked[nb].proc     = proc_on_CPU;
-    devices[device].blocked[nb].syscall  = syscall;
-    devices[device].blocked[nb].nbytes   = nbytes;
-    ++devices[device].nblocked;
-    ++nblocked;
-}
+//  MAP A (NON-EMPTY) REGULAR FILE
+    if(S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map   = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
 
-//  AS ONLY ONE PROCESS CAN OWN THE DATABUS, ONLY ONE PROCESS WILL BE UNBLOCKED
-void unblock_completed_IO(void)
-{
-    if(device_owning_databus != UNKNOWN && databus_inuse_until <= USECS_SINCE_REBOOT) {
-        int proc    = devices[device_owning_databus].blocked[0].proc;
-        int s       = devices[device_owning_databus].blocked[0].syscall;
+        if(map != MAP_FAILED) {
+            posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+            in->map     = map;
+            in->size    = st.st_size;
+            in->mapped  = true;
+        }
+    }
 
-        DEBUG("device.%s completes %s", devices[device_owning_databus].name, syscalls[s]);
-        DEBUG("DATABUS is now idle");
-        flush_DEBUG(UNKNOWN);
+//  OTHERWISE, READ ALL OF IT
+    if(!in->mapped) {
+        size_t  capacity    = 0;
+        ssize_t got         = 1;
 
-        append_to_READY_queue(proc, "BLOCKED");
-        advance_time(TIME_CORE_STATE_TRANSITIONS);
+        while(got > 0) {
+            if(in->size == capacity) {
+                capacity        = (capacity == 0) ? BUFSIZ : 2*capacity;
+                char *newmap    = realloc(in->map, capacity);
 
-        int nb  = devices[device_owning_databus].nblocked;
-        for(int b=0 ; b < (nb-1) ; ++b) {               // 'slide' all left by 1
-            devices[device_owning_databus].blocked[b]   = devices[device_owning_databus].blocked[b+1];
+                if(newmap == NULL) {
+                    close(fd);
+                    fail(f, "ERROR - out of memory reading '%s'", filename);
+                }
+                in->map     = newmap;
+            }
+            got = read(fd, in->map + in->size, capacity - in->size);
+            if(got > 0) {
+                in->size   += got;
+            }
+        }
+        if(got < 0) {
+            close(fd);
+            fail(f, "ERROR - cannot read '%s'", filename);
         }
-        --devices[device_owning_databus].nblocked;
-        --nblocked;
-
-        device_owning_databus   = UNKNOWN;
-        databus_inuse_until     = UNKNOWN;
     }
+    close(fd);
+    in->mtime   = st.st_mtime;
+    in->p       = in->map;
+    in->end = in->map + in->size;
 }
 
-//  FIND THE FASTEST READING DEVICE READY TO PERFORM I/O
-int find_fastest_ready_device(void)
+void close_scanner(struct scanner *in)
 {
-    int fastest_ready_device    = UNKNOWN;
-    int fastest_speed           = -1;
-
-    FOREACH_DEVICE {
-        if(devices[d].nblocked > 0 && devices[d].read_speed > fastest_speed) {
-            fastest_ready_device    = d;
-            fastest_speed           = devices[d].read_speed;
+    if(in->map != NULL) {
+        if(in->mapped) {
+            munmap(in->map, in->size);
+        }
+        else {
+            free(in->map);
         }
+        in->map = NULL;
     }
-    return  fastest_ready_device;
 }
 
-void start_pending_IO(void)
+//  REPORT AN ERROR AT THE GIVEN CHARACTER OF THE CURRENT LINE
+void scan_error(struct failure *f, struct scanner *in, const char *at, char *fmt, ...)
 {
-//  IF NO DEVICE CURRENTLY OWNS (IS USING) THE DATABUS, AND OTHERS WISH TO
-    if(device_owning_databus == UNKNOWN && nblocked > 0) {
-        device_owning_databus   = find_fastest_ready_device();
+    char    message[BUFSIZ];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(message, sizeof message, fmt, ap);
+    va_end(ap);
+    fail(f, "ERROR - line %i, column %i of '%s': %s",
+            in->lc, (int)(at - in->line_start) + 1, in->filename, message);
+}
 
-//  DETERMINE HOW LONG THIS I/O WILL TAKE
-        int s       = devices[device_owning_databus].blocked[0].syscall;
-        int nbytes  = devices[device_owning_databus].blocked[0].nbytes;
-        int speed;
-        char *doing;
+//  MOVE TO THE START OF THE NEXT LINE, RETURNING false AT THE END OF THE FILE
+bool next_line(struct scanner *in)
+{
+    if(in->lc > 0) {
+        const char  *nl = memchr(in->p, '\n', in->end - in->p);
 
-        if(s == SYS_READ) {
-            speed   = devices[device_owning_databus].read_speed;
-            doing   = "reading";
-        }
-        else /* SYS_WRITE */ {
-            speed   = devices[device_owning_databus].write_speed;
-            doing   = "writing";
-        }
+        in->p   = (nl == NULL) ? in->end : nl+1;
+    }
+    if(in->p >= in->end) {
+        return false;
+    }
+    in->line_start  = in->p;
+    ++in->lc;
+    return true;
+}
 
-        int usecs               = ceil(1000000.0*(double)nbytes / (double)speed);
-        databus_inuse_until     = USECS_SINCE_REBOOT + TIME_ACQUIRE_BUS + usecs;
+static inline bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
 
-        DEBUG("device.%s acquiring DATABUS, %s %i bytes, will take %iusecs (%i+%i)",
-                devices[device_owning_databus].name, doing, nbytes,
-                TIME_ACQUIRE_BUS+usecs, TIME_ACQUIRE_BUS, usecs);
-        flush_DEBUG(UNKNOWN);
+void skip_blanks(struct scanner *in)
+{
+    while(in->p < in->end && is_blank(*in->p)) {
+        ++in->p;
     }
 }
 
-int find_device_byname(char name[])
+bool at_end_of_line(struct scanner *in)
 {
-    FOREACH_DEVICE {
-        if(strcmp(devices[d].name, name) == 0) {
-            return d;
-        }
+    skip_blanks(in);
+    return in->p == in->end || *in->p == '\n';
+}
+
+//  RETURN THE LENGTH OF THE NEXT WORD ON THIS LINE, AND WHERE IT IS
+int scan_word(struct failure *f, struct scanner *in, const char **word, const char what[])
+{
+    if(at_end_of_line(in)) {
+        scan_error(f, in, in->p, "expected %s", what);
     }
-    printf("ERROR - device '%s' not found\n", name);
-    exit(EXIT_FAILURE);
+    *word   = in->p;
+    while(in->p < in->end && !is_blank(*in->p) && *in->p != '\n') {
+        ++in->p;
+    }
+    return in->p - *word;
 }
 
-//  ----------------------------------------------------------------------
+bool word_is(const char word[], int length, const char name[])
+{
+    return strncmp(word, name, length) == 0 && name[length] == '\0';
+}
 
-//  AN ARRAY AND FUNCTIONS TO MANAGE THE SYSTEM'S READY QUEUE
+//  SCAN THE DIGITS OF AN INTEGER, WHICH MAY BE NEGATIVE
+long long scan_integer(struct failure *f, struct scanner *in, const char what[])
+{
+    const char  *start      = in->p;
+    bool        negative    = (in->p < in->end && *in->p == '-');
+    long long   value       = 0;
 
-int READY_queue[MAX_RUNNING_PROCESSES];         // indicies into processes[]
-int nready          = 0;
+    if(negative) {
+        ++in->p;
+    }
+    if(in->p == in->end || *in->p < '0' || *in->p > '9') {
+        scan_error(f, in, start, "expected %s", what);
+    }
+    while(in->p < in->end && *in->p >= '0' && *in->p <= '9') {
+        int digit   = *in->p++ - '0';
 
-void init_READY_queue(void)
-{
-    nready          = 0;
+        if(value > (LLONG_MAX - digit) / 10) {
+            scan_error(f, in, start, "number is too large");
+        }
+        value   = 10*value + digit;
+    }
+    return negative ? -value : value;
 }
 
-void append_to_READY_queue(int proc, char came_from[])
+//  SKIP THE UNITS, SUCH AS usecs OR B, THAT MAY END A VALUE STARTING AT start
+void skip_units(struct failure *f, struct scanner *in, const char *start, const char what[])
 {
-    DEBUG("pid%i.%s->READY", processes[proc].pid, came_from);
-    processes[proc].state   = STATE_READY;
-    READY_queue[nready]     = proc;
-    ++nready;
+    while(in->p < in->end && isalpha((unsigned char)*in->p)) {
+        ++in->p;
+    }
+    if(in->p < in->end && !is_blank(*in->p) && *in->p != '\n') {
+        scan_error(f, in, start, "expected %s", what);
+    }
 }
 
-int dequeue_READY_queue(void)
+//  SCAN AN INTEGER, WHICH MAY BE FOLLOWED BY ITS UNITS
+long long scan_number(struct failure *f, struct scanner *in, const char what[])
 {
-    int proc    = UNKNOWN;
+    if(at_end_of_line(in)) {
+        scan_error(f, in, in->p, "expected %s", what);
+    }
 
-    if(nready > 0) {
-        proc   = READY_queue[0];                // head of queue
-        DEBUG("pid%i.READY->RUNNING", processes[proc].pid);
-        advance_time(TIME_CONTEXT_SWITCH);
+    const char  *start  = in->p;
+    long long   value   = scan_integer(f, in, what);
 
-        for(int r=0 ; r<(nready-1) ; ++r) {     // 'slide' all left by 1
-            READY_queue[r]  = READY_queue[r+1];
-        }
-        --nready;
+    skip_units(f, in, start, what);
+    return value;
+}
+
+//  A LINE MUST NOT HAVE ANY WORDS AFTER THOSE EXPECTED
+void expect_end_of_line(struct failure *f, struct scanner *in)
+{
+    if(!at_end_of_line(in)) {
+        scan_error(f, in, in->p, "unexpected text at end of line");
     }
-    return proc;
 }
 
 //  ----------------------------------------------------------------------
 
-//  NOTHING TO UNDERSTAND IN THIS SECTION! - (see  man stdarg  if interested)
-#include <stdarg.h>
-
-#define MAX_DEBUG_LINES     100000
+//  EACH DISTINCT NAME (OF A SYSCALL, DEVICE, OR COMMAND) IS STORED ONCE, AS A
+//  SYMBOL, AND IS FOUND BY AN OPEN-ADDRESSING HASH TABLE AS THE INPUT FILES
+//  ARE READ.  AFTER THAT, EVERYTHING REFERS TO SYSCALLS, DEVICES, AND
+//  COMMANDS BY THEIR INDICES, AND NAMES ARE ONLY NEEDED TO PRINT THEM.
+
+struct symbol {
+    int         name;                   // offset into symbol_names[]
+    unsigned    hash;
+    int         syscall;                // SYS_SPAWN ..., or UNKNOWN
+    int         device;                 // index into devices[], or UNKNOWN
+    int         command;                // index into commands[], or UNKNOWN
+};
 
-char    debugging[256]  = { '\0' };
-char    *dp             = debugging;
+#define SYMBOL_NAME(w, sym) (&(w)->symbol_names[(w)->symbols[sym].name])
 
-void DEBUG(char *fmt, ...)
+unsigned hash_name(const char name[], int length)
 {
-    if(verbose) {
-        va_list ap;
+    unsigned    hash    = 2166136261u;  // 32-bit FNV-1a
 
-        if(debugging[0]) {
-            *dp++   = ',';
-            *dp++   = ' ';
-        }
-        va_start(ap, fmt);
-        vsprintf(dp, fmt, ap);
-        va_end(ap);
+    for(int i=0 ; i<length ; ++i) {
+        hash    = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return hash;
+}
 
-        while(*dp) {
-            ++dp;
+//  REBUILD THE HASH TABLE, KEEPING IT AT MOST HALF FULL
+void grow_symbol_hash(struct workload *w)
+{
+    free(w->symbol_hash);
+    w->symbol_hash_size = (w->symbol_hash_size == 0) ? 64 : 2*w->symbol_hash_size;
+    w->symbol_hash      = malloc(w->symbol_hash_size * sizeof w->symbol_hash[0]);
+    if(w->symbol_hash == NULL) {
+        fail(&w->failure, "ERROR - out of memory for %i symbols", w->symbol_hash_size);
+    }
+    for(int h=0 ; h<w->symbol_hash_size ; ++h) {
+        w->symbol_hash[h]   = UNKNOWN;
+    }
+    for(int sym=0 ; sym<w->nsymbols ; ++sym) {
+        int h   = w->symbols[sym].hash & (w->symbol_hash_size-1);
+
+        while(w->symbol_hash[h] != UNKNOWN) {
+            h   = (h+1) & (w->symbol_hash_size-1);
         }
+        w->symbol_hash[h]   = sym;
     }
 }
 
-void flush_DEBUG(int proc_on_CPU)
+//  FIND THE HASH TABLE ENTRY HOLDING, OR THAT WOULD HOLD, THE GIVEN NAME
+int *find_symbol_hash(const struct workload *w, const char name[], int length, unsigned hash)
 {
-    if(debugging[0]) {                     // anything to output?
-        char rhs[MAX_COMMAND_NAME+24];
-        rhs[0]  = '\0';
+    int h   = hash & (w->symbol_hash_size-1);
 
-        if(debugging[0] == '+') {
-            strcpy(rhs, "OS");
-        }
-        else if(proc_on_CPU != UNKNOWN) {
-            sprintf(rhs, "%s(onCPU=%i)",
-                            commands[processes[proc_on_CPU].command ].name,
-                            processes[proc_on_CPU].time_on_CPU);
-        }
-        printf("@%08i   %-80s%24s\n", USECS_SINCE_REBOOT, debugging, rhs);
+    while(w->symbol_hash[h] != UNKNOWN) {
+        struct symbol *sym  = &w->symbols[w->symbol_hash[h]];
 
-        static  int     nlines          = 0;
-        if(++nlines >= MAX_DEBUG_LINES) {
-            printf("ERROR - too much debug output - giving up!\n");
-            exit(EXIT_FAILURE);
+        if(sym->hash == hash && strncmp(&w->symbol_names[sym->name], name, length) == 0 &&
+                                w->symbol_names[sym->name + length] == '\0') {
+            break;
         }
-        debugging[0]    = '\0';
-        dp              = debugging;
+        h   = (h+1) & (w->symbol_hash_size-1);
     }
+    return &w->symbol_hash[h];
 }
-#undef  MAX_DEBUG_LINES
 
-//  ----------------------------------------------------------------------
-
-#define CHAR_COMMENT            '#'
+//  RETURN THE SYMBOL OF AN EXISTING NAME, OR UNKNOWN
+int find_symbol(const struct workload *w, const char name[], int length)
+{
+    if(w->symbol_hash_size == 0) {
+        return UNKNOWN;
+    }
+    return *find_symbol_hash(w, name, length, hash_name(name, length));
+}
 
-void read_sysconfig(char argv0[], char filename[])
+//  RETURN THE SYMBOL OF A NAME, ADDING A NEW SYMBOL IF NOT ALREADY KNOWN
+int intern(struct workload *w, const char name[], int length)
 {
-    FILE    *fp = fopen(filename, "r");
-    if(fp == NULL) {
-        printf("%s: cannot open '%s'\n", argv0, filename);
-        exit(EXIT_FAILURE);
+    if(2*(w->nsymbols+1) > w->symbol_hash_size) {
+        grow_symbol_hash(w);
     }
 
-//  READ EACH LINE OF THE sysconfig FILE
-    int lc=0;
-    char line[BUFSIZ];
-    while(fgets(line, sizeof line, fp) != NULL) {
-        ++lc;
-        if(line[0] == CHAR_COMMENT) {       // ignore this line
-            continue;
-        }
+    unsigned    hash    = hash_name(name, length);
+    int         *h      = find_symbol_hash(w, name, length, hash);
 
-        char word0[MAX_WORD], word1[MAX_WORD], word2[MAX_WORD];
+    if(*h == UNKNOWN) {
+        w->symbols      = grow_table(&w->failure, w->symbols, &w->symbols_capacity,
+                                        w->nsymbols+1, sizeof w->symbols[0]);
+        w->symbol_names = grow_table(&w->failure, w->symbol_names, &w->symbol_names_capacity,
+                                        w->symbol_names_size+length+1, 1);
 
-//  FOUND A DEVICE DEFINITION
-        if(sscanf(line, "device %s %s %s", word0, word1, word2) == 3) {
-            add_device(word0, atoi(word1), atoi(word2));
-        }
+        struct symbol *sym  = &w->symbols[w->nsymbols];
 
-//  FOUND THE timequantum
-        else if(sscanf(line, "timequantum %s", word0) == 1) {
-            timequantum = atoi(word0);
-        }
-        else {
-            printf("ERROR - line %i of '%s' is not recognized\n", lc, filename);
-            exit(EXIT_FAILURE);
-        }
+        sym->name       = w->symbol_names_size;
+        sym->hash       = hash;
+        sym->syscall    = UNKNOWN;
+        sym->device     = UNKNOWN;
+        sym->command    = UNKNOWN;
+
+        memcpy(&w->symbol_names[w->symbol_names_size], name, length);
+        w->symbol_names[w->symbol_names_size+length]    = '\0';
+        w->symbol_names_size   += length+1;
+        *h  = w->nsymbols++;
     }
-    fclose(fp);
+    return *h;
 }
 
-//  NOT REQUIRED, BUT PROVIDES A CHECK THAT THINGS HAVE BEEN STORED CORRECTLY
-void dump_sysconfig(void)
+//  THE NAMES OF ALL SYSCALLS ARE KNOWN BEFORE ANY INPUT IS READ
+void init_symbols(struct workload *w)
 {
-    FOREACH_DEVICE {
-        printf("%s\t%i\t%i\n", devices[d].name, devices[d].read_speed, devices[d].write_speed);
+    for(int s=0 ; syscalls[s] != NULL ; ++s) {
+        int sym = intern(w, syscalls[s], strlen(syscalls[s]));
+
+        w->symbols[sym].syscall = s;
     }
-    printf("#\ntimequantum\t%i\n#\n", timequantum);
+}
+
+int find_syscall_byname(const struct workload *w, const char name[], int length)
+{
+    int sym = find_symbol(w, name, length);
+
+    return (sym == UNKNOWN) ? UNKNOWN : w->symbols[sym].syscall;
 }
 
 //  ----------------------------------------------------------------------
 
-void read_commands(char argv0[], char filename[])
-{
-    FILE    *fp = fopen(filename, "r");
-    if(fp == NULL) {
-        printf("%s: cannot open '%s'\n", argv0, filename);
-        exit(EXIT_FAILURE);
-    }
+//  A SYSCALL'S TIME, A SLEEP'S DURATION, AND AN I/O'S SIZE MAY EACH BE A FIXED
+//  NUMBER, OR BE DRAWN FROM A DISTRIBUTION, SUCH AS exponential(200)usecs.
+//  WHILE A FIXED TIME IS THE PROCESS'S TOTAL usecs ONCPU, A DRAWN TIME IS ITS
+//  usecs OF COMPUTATION SINCE ITS PREVIOUS SYSCALL.
+//
+//  EACH PROCESS DRAWS FROM ITS OWN STREAM OF A COUNTER-BASED GENERATOR, KEYED
+//  BY THE seed AND BY THE PROCESS'S PLACE IN THE TREE OF SPAWNS, SO THE SAME
+//  VALUES ARE DRAWN HOWEVER (AND IN WHICHEVER THREAD) ITS PROCESSES EXECUTE.
+
+#define DISTRIBUTION_UNIFORM        0       // uniform(lo,hi)
+#define DISTRIBUTION_EXPONENTIAL    1       // exponential(mean)
+#define DISTRIBUTION_LOGNORMAL      2       // lognormal(mean,stddev)
+#define DISTRIBUTION_EMPIRICAL      3       // empirical(value,value,...), equally likely
+
+char *distribution_kinds[] = {
+    "uniform", "exponential", "lognormal", "empirical", NULL
+};
 
-//  READ EACH LINE OF THE commands FILE
-    int     lc=0;
-    char    line[BUFSIZ];
-    while(fgets(line, sizeof line, fp) != NULL) {
-        ++lc;
-        if(line[0] == CHAR_COMMENT) {       // ignore this line
-            continue;
-        }
+//  THE NUMBER OF PARAMETERS OF EACH KIND, OR UNKNOWN IF ANY NUMBER
+int distribution_nparams[] = { 2, 1, 2, UNKNOWN };
 
-//  FOUND A NEW COMMAND
-        if(isalnum(line[0])) {
-            add_command(line);
-        }
-//  FOUND A NEW SYSCALL FOR THE CURRENT COMMAND
-        else if(line[0] == '\t' && ncommands > 0) {
-            add_syscall_to_command(line);
-        }
-        else {
-            printf("ERROR - line %i of '%s' is not recognized\n", lc, filename);
-            exit(EXIT_FAILURE);
+struct distribution {
+    int         kind;                       // DISTRIBUTION_UNIFORM ...
+    int         first_param;                // index into distribution_params[]
+    int         nparams;
+};
+
+#define DEFAULT_SEED                0
+
+//  DRAWN VALUES ARE LIMITED TO ABOUT 31 YEARS OF usecs
+#define MAX_DRAWN_VALUE             1e15
+
+#define TWO_PI                      6.283185307179586
+
+int find_distribution_byname(const char name[], int length)
+{
+    for(int d=0 ; distribution_kinds[d] != NULL ; ++d) {
+        if(word_is(name, length, distribution_kinds[d])) {
+            return d;
         }
     }
-    fclose(fp);
-    patch_commands();
+    return UNKNOWN;
 }
 
-//  NOT REQUIRED, BUT PROVIDES A CHECK THAT THINGS HAVE BEEN STORED CORRECTLY
-void dump_commands(void)
+//  SCAN A NUMBER, OR A DISTRIBUTION FROM WHICH IT WILL BE DRAWN (SETTING
+//  *distribution TO ITS INDEX, ELSE UNKNOWN), EITHER FOLLOWED BY ITS UNITS
+long long scan_value(struct workload *w, struct scanner *in, const char what[], int *distribution)
 {
-    FOREACH_COMMAND {
-        printf("%s\n", commands[c].name);
+    *distribution   = UNKNOWN;
+    if(at_end_of_line(in) || !isalpha((unsigned char)*in->p)) {
+        return scan_number(&w->failure, in, what);
+    }
 
-        for(int s=0 ; s<commands[c].nsyscalls ; ++s) {
-            switch (commands[c].syscalls[s].which) {
-            case SYS_SPAWN:
-                printf("\t%i\t%s\t%s\n", 
-                    commands[c].syscalls[s].when,
-                    syscalls[commands[c].syscalls[s].which] ,
-                    commands[commands[c].syscalls[s].arg0].name );
-                break;
+    const char  *start  = in->p;
+    while(in->p < in->end && isalpha((unsigned char)*in->p)) {
+        ++in->p;
+    }
 
-            case SYS_READ:
-            case SYS_WRITE:
-                printf("\t%i\t%s\t%s\t%i\n", 
-                    commands[c].syscalls[s].when,
-                    syscalls[commands[c].syscalls[s].which] ,
-                    devices[commands[c].syscalls[s].arg0].name,
-                    commands[c].syscalls[s].arg1    );
-                break;
+    struct distribution new = { find_distribution_byname(start, in->p - start), w->ndistribution_params, 0 };
 
-            case SYS_SLEEP:
-                printf("\t%i\t%s\t%i\n", 
-                    commands[c].syscalls[s].when,
-                    syscalls[commands[c].syscalls[s].which],
-                    commands[c].syscalls[s].arg0    );
-                break;
+    if(new.kind == UNKNOWN || in->p == in->end || *in->p != '(') {
+        scan_error(&w->failure, in, start, "expected %s or a distribution", what);
+    }
 
-            case SYS_WAIT:
-            case SYS_EXIT:
-                printf("\t%i\t%s\n", 
-                    commands[c].syscalls[s].when,
-                    syscalls[commands[c].syscalls[s].which] );
-                break;
-            }
+//  ITS PARAMETERS ARE SEPARATED BY COMMAS, WITHOUT BLANKS
+    do {
+        const char  *param  = ++in->p;
+        long long   value   = scan_integer(&w->failure, in, "a parameter");
+
+        if(value < 0) {
+            scan_error(&w->failure, in, param, "parameter must not be negative");
         }
+        w->distribution_params  = grow_table(&w->failure, w->distribution_params,
+                                    &w->distribution_params_capacity,
+                                    w->ndistribution_params+1, sizeof w->distribution_params[0]);
+        w->distribution_params[w->ndistribution_params++]   = value;
+        ++new.nparams;
+    } while(in->p < in->end && *in->p == ',');
+
+    if(in->p == in->end || *in->p != ')') {
+        scan_error(&w->failure, in, in->p, "expected ',' or ')'");
     }
-}
-
-//  ----------------------------------------------------------------------
+    ++in->p;
+    skip_units(&w->failure, in, start, what);
 
-//  AN ARRAY AND FUNCTIONS TO MANAGE THE SYSTEM'S WAITING QUEUE
+    long long   *param  = &w->distribution_params[new.first_param];
 
-int WAITING_queue[MAX_RUNNING_PROCESSES];       // indicies into processes[]
+    if(distribution_nparams[new.kind] != UNKNOWN && new.nparams != distribution_nparams[new.kind]) {
+        scan_error(&w->failure, in, start, "%s expects %i parameter%s", distribution_kinds[new.kind],
+                    distribution_nparams[new.kind], (distribution_nparams[new.kind] == 1) ? "" : "s");
+    }
+    if((new.kind == DISTRIBUTION_UNIFORM && param[0] > param[1]) ||
+       (new.kind == DISTRIBUTION_LOGNORMAL && param[0] == 0)) {
+        scan_error(&w->failure, in, start, "invalid parameters of %s", distribution_kinds[new.kind]);
+    }
 
-int nwaiting                = 0;
-#define FOREACH_WAITING     for(int w=0 ; w<nwaiting ; ++w)
+    w->distributions    = grow_table(&w->failure, w->distributions, &w->distributions_capacity,
+                                w->ndistributions+1, sizeof w->distributions[0]);
+    w->distributions[w->ndistributions] = new;
+    *distribution       = w->ndistributions++;
+    return 0;
+}
 
-void init_WAITING_queue(void)
+static inline unsigned long long mix64(unsigned long long x)
 {
-    nwaiting    = 0;
+    x   = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x   = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
 }
 
-void append_to_WAITING_queue(int proc_on_CPU)
+//  THE draw'TH VALUE, IN (0,1), OF THE STREAM WITH THE GIVEN key
+double random_uniform(unsigned long long key, long long draw)
 {
-    DEBUG("wait, pid%i.RUNNING->WAITING", processes[proc_on_CPU].pid);
-    flush_DEBUG(processes[proc_on_CPU].command);
+    unsigned long long  bits    = mix64(key ^ mix64((unsigned long long)draw));
 
-    WAITING_queue[nwaiting]         = proc_on_CPU;
-    processes[proc_on_CPU].state    = STATE_WAITING;
-    ++nwaiting;
+    return ((bits >> 11) + 0.5) * 0x1.0p-53;
 }
 
-void unblock_WAITING(void)
+//  DRAW A VALUE FROM A DISTRIBUTION, ADVANCING THE STREAM'S COUNTER OF DRAWS
+long long draw_from_distribution(const struct workload *w, int distribution,
+                                 unsigned long long key, long long *ndraws)
 {
-    FOREACH_WAITING {
-        int proc   = WAITING_queue[w];
+    const struct distribution   *d      = &w->distributions[distribution];
+    const long long             *param  = &w->distribution_params[d->first_param];
+    double  u   = random_uniform(key, (*ndraws)++);
+    double  x   = 0.0;
+
+    switch (d->kind) {
+        case DISTRIBUTION_UNIFORM:
+            x   = param[0] + floor(u * (param[1] - param[0] + 1));
+            break;
 
-        if(processes[proc].state == STATE_WAITING && processes[proc].nchildren == 0) {
-            append_to_READY_queue(proc, "WAITING");
-            advance_time(TIME_CORE_STATE_TRANSITIONS);
+        case DISTRIBUTION_EXPONENTIAL:
+            x   = -param[0] * log(u);
+            break;
 
-            for(int t=w ; t<(nwaiting-1) ; ++t) {       // 'slide' all left by 1
-                WAITING_queue[t]   = WAITING_queue[t+1];
-            }
-            --nwaiting;
-            --w;
+//  FROM THE MEAN AND stddev OF THE VALUES, THOSE OF THEIR LOGARITHMS
+        case DISTRIBUTION_LOGNORMAL: {
+            double  mean    = param[0];
+            double  stddev  = param[1];
+            double  var     = log1p((stddev*stddev) / (mean*mean));
+            double  z       = sqrt(-2.0*log(u)) * cos(TWO_PI*random_uniform(key, (*ndraws)++));
+
+            x   = exp(log(mean) - var/2.0 + sqrt(var)*z);
+            break;
         }
+        case DISTRIBUTION_EMPIRICAL:
+            x   = param[(int)(u * d->nparams)];
+            break;
     }
+    return (x < MAX_DRAWN_VALUE) ? llround(x) : (long long)MAX_DRAWN_VALUE;
 }
 
-//  ----------------------------------------------------------------------
+//  THE MEAN OF THE VALUES DRAWN FROM A DISTRIBUTION
+double distribution_mean(const struct workload *w, int distribution)
+{
+    const struct distribution   *d      = &w->distributions[distribution];
+    const long long             *param  = &w->distribution_params[d->first_param];
+    double  mean    = 0.0;
+
+    switch (d->kind) {
+        case DISTRIBUTION_UNIFORM:
+            mean    = (param[0] + param[1]) / 2.0;
+            break;
+
+        case DISTRIBUTION_EXPONENTIAL:
+        case DISTRIBUTION_LOGNORMAL:
+            mean    = param[0];
+            break;
+
+        case DISTRIBUTION_EMPIRICAL:
+            for(int p=0 ; p<d->nparams ; ++p) {
+                mean   += param[p];
+            }
+            mean   /= d->nparams;
+            break;
+    }
+    return (mean < MAX_DRAWN_VALUE) ? mean : MAX_DRAWN_VALUE;
+}
+
+//  ----------------------------------------------------------------------
+
+//  AN ARRAY OF STRUCTURES AND FUNCTIONS TO MANAGE THE SYSTEM'S KNOWN COMMANDS
+
+//  EACH SYSCALL PACKS INTO 32 BYTES, TWO PER CACHE LINE, AND EACH COMMAND'S
+//  SYSCALLS ARE CONTIGUOUS IN all_syscalls[], SO A RUNNING PROCESS WALKS
+//  THEM IN ORDER AND NEVER RE-READS ITS COMMAND.
+
+struct syscall {
+    usecs_t     when;                           // usecs of onCPU time
+    long long   arg;                            // its sleep time or #bytes
+    int         operand;                        // the device, or spawned command
+                                                // (its symbol until patched)
+    int         which;                          // which system-call
+    int         when_distribution;              // or UNKNOWN if fixed
+    int         arg_distribution;               // of its sleep time or #bytes
+};
+
+struct command {
+    int             symbol;                     // index into symbols[]
+    int             first_syscall;              // index into all_syscalls[]
+    int             nsyscalls;
+    int             priority;                   // lower is more urgent
+};
+
+//  A COMMAND'S NAME MAY BE FOLLOWED BY ITS PRIORITY, FOR THE priority SCHEDULER
+#define DEFAULT_PRIORITY                0
+
+#define FOREACH_COMMAND(w)  for(int c=0 ; c<(w)->ncommands ; ++c)
+#define COMMAND_NAME(w, c)  SYMBOL_NAME(w, (w)->commands[c].symbol)
+#define COMMAND_SYSCALL(w, c, s)    (&(w)->all_syscalls[(w)->commands[c].first_syscall + (s)])
+
+void add_command(struct workload *w, struct scanner *in)
+{
+    w->commands = grow_table(&w->failure, w->commands, &w->commands_capacity,
+                                w->ncommands+1, sizeof w->commands[0]);
+
+    const char  *name;
+    int         length  = scan_word(&w->failure, in, &name, "a command name");
+    int         sym     = intern(w, name, length);
+
+    if(w->symbols[sym].command == UNKNOWN) {    // first definition is used
+        w->symbols[sym].command = w->ncommands;
+    }
+    w->commands[w->ncommands].symbol          = sym;
+    w->commands[w->ncommands].first_syscall   = w->nall_syscalls;
+    w->commands[w->ncommands].nsyscalls       = 0;
+    w->commands[w->ncommands].priority        = DEFAULT_PRIORITY;
+    if(!at_end_of_line(in)) {
+        w->commands[w->ncommands].priority    = scan_number(&w->failure, in, "a priority");
+    }
+    expect_end_of_line(&w->failure, in);
+    ++w->ncommands;
+}
+
+int find_command_bysymbol(struct workload *w, int sym)
+{
+    if(w->symbols[sym].command == UNKNOWN) {
+        fail(&w->failure, "ERROR - command '%s' not found", SYMBOL_NAME(w, sym));
+    }
+    return w->symbols[sym].command;
+}
+
+//  A COMMAND'S SYSCALLS ARE ALWAYS THE LAST ONES IN all_syscalls[]
+void add_syscall_to_command(struct workload *w, struct scanner *in)
+{
+    w->all_syscalls = grow_table(&w->failure, w->all_syscalls, &w->all_syscalls_capacity,
+                                    w->nall_syscalls+1, sizeof w->all_syscalls[0]);
+
+    struct syscall *sc  = &w->all_syscalls[w->nall_syscalls];
+    const char  *word;
+    int         length;
+
+    sc->when    = scan_value(w, in, "a time", &sc->when_distribution);
+    length      = scan_word(&w->failure, in, &word, "a syscall");
+    sc->which   = find_syscall_byname(w, word, length);
+    sc->arg_distribution    = UNKNOWN;
+
+    switch (sc->which) {
+        case SYS_SPAWN:
+            length      = scan_word(&w->failure, in, &word, "a command name");
+            sc->operand = intern(w, word, length);
+            break;
+
+        case SYS_READ:
+        case SYS_WRITE:
+            length      = scan_word(&w->failure, in, &word, "a device name");
+            sc->operand = find_device_byname(w, word, length);
+            if(sc->operand == UNKNOWN) {
+                scan_error(&w->failure, in, word, "device '%.*s' not found", length, word);
+            }
+            sc->arg     = scan_value(w, in, "a number of bytes", &sc->arg_distribution);
+            break;
+
+        case SYS_SLEEP:
+            sc->arg     = scan_value(w, in, "a sleep time", &sc->arg_distribution);
+            break;
+
+        case SYS_WAIT:
+        case SYS_EXIT:
+            break;
+
+        default:
+            scan_error(&w->failure, in, word, "syscall '%.*s' not found", length, word);
+    }
+    expect_end_of_line(&w->failure, in);
+    ++w->nall_syscalls;
+    ++w->commands[w->ncommands-1].nsyscalls;
+}
+
+//  FIND COMMAND-NAMES FOR SYS_SPAWN, ENSURE A CALL TO SYS_EXIT
+void patch_commands(struct workload *w)
+{
+    FOREACH_COMMAND(w) {
+        bool exit_found = false;
+        for(int s=0 ; s<w->commands[c].nsyscalls ; ++s) {
+            struct syscall *sc  = COMMAND_SYSCALL(w, c, s);
+
+            if(sc->which == SYS_SPAWN) {
+                sc->operand = find_command_bysymbol(w, sc->operand);
+            }
+            else if(sc->which == SYS_EXIT) {
+                exit_found  = true;
+            }
+        }
+        if(!exit_found && w->warnings != NULL) {
+            char warning[BUFSIZ];
+
+            snprintf(warning, sizeof warning, "WARNING - command '%s' never calls 'exit'",
+                        COMMAND_NAME(w, c));
+            print_DEBUG_line(w->warnings, 0, w->config.ncores, 0, warning, "", "");
+        }
+    }
+}
+
+//  ----------------------------------------------------------------------
+
+//  AN ARRAY OF STRUCTURES AND FUNCTIONS TO MANAGE THE SYSTEM'S PROCESSES
+
+//  THE FIELDS NEEDED TO EXECUTE AND QUEUE A PROCESS ARE KEPT IN processes[],
+//  THOSE TOUCHED FOR EVERY EVENT IN ITS FIRST CACHE LINE.  ITS HISTORY, NEEDED
+//  ONLY TO REPORT METRICS, IS KEPT APART IN histories[], AT THE SAME INDEX.
+
+#define NO_MORE_SYSCALLS                LLONG_MAX   // its syscall_at, when none remain
+
+struct process {
+    usecs_t     time_on_CPU;
+    usecs_t     syscall_at;             // the time_on_CPU of its next syscall
+    int         next_syscall;           // index into all_syscalls[]
+    int         end_syscall;            // after its command's last syscall
+    int         state;                  // STATE_READY, STATE_RUNNING ...
+    int         next, prev;             // links within its current queue,
+                                        // or the free list if slot unused
+    int         command;                // index into commands[]
+    int         nchildren;              // other processes invoked by 'spawn'
+    usecs_t     state_since;            // when it entered its current state
+
+    long long   pid, ppid;              // never reused
+    int         parent;                 // index into processes[], iff ppid
+    int         io_syscall;             // SYS_READ or SYS_WRITE, iff BLOCKED
+    long long   io_nbytes;              // size of I/O request, iff BLOCKED
+    long long   waiting_seq;            // order it began WAITING, iff WAITING
+
+    int         level;                  // MLFQ level
+    long long   epoch;                  // MLFQ boosts when last dequeued
+    usecs_t     vruntime_lag;           // CFS virtual runtime - time_on_CPU
+
+    unsigned long long  random_key;     // of its stream of random values
+    long long   ndraws;                 // values drawn from its stream
+};
+
+struct history {
+    usecs_t     spawned_at;
+    usecs_t     time_in_state[STATE_NEW+1];
+    bool        has_run;                // been on a CPU yet?
+};
+
+//  THE TABLES GROW AS MORE PROCESSES RUN AT ONCE, UP TO MAX_RUNNING_PROCESSES.
+//  SLOTS OF EXITED PROCESSES ARE KEPT ON A FREE LIST, FOR REUSE IN O(1).
+
+void init_processes(struct simulation *sim)
+{
+    sim->nprocesses         = 0;
+    sim->nslots             = 0;
+    sim->first_free_slot    = UNKNOWN;
+    sim->next_pid           = 0;
+    sim->nspawned           = 0;
+}
+
+int allocate_process_slot(struct simulation *sim)
+{
+    int p   = sim->first_free_slot;
+
+    if(p != UNKNOWN) {
+        sim->first_free_slot    = sim->processes[p].next;
+    }
+    else {
+        if(sim->nslots == MAX_RUNNING_PROCESSES) {
+            fail(&sim->failure, "ERROR - process limit of %i exceeded", MAX_RUNNING_PROCESSES);
+        }
+        sim->processes  = grow_table(&sim->failure, sim->processes, &sim->processes_capacity,
+                                        sim->nslots+1, sizeof sim->processes[0]);
+        sim->histories  = grow_table(&sim->failure, sim->histories, &sim->histories_capacity,
+                                        sim->nslots+1, sizeof sim->histories[0]);
+        p               = sim->nslots++;
+    }
+    return p;
+}
+
+void free_process_slot(struct simulation *sim, int p)
+{
+    sim->processes[p].pid   = UNKNOWN;      // => unused slot
+    sim->processes[p].next  = sim->first_free_slot;
+    sim->first_free_slot    = p;
+}
+
+//  ----------------------------------------------------------------------
+
+//  A FIFO QUEUE OF PROCESSES, LINKED THROUGH THEIR ENTRIES IN processes[].
+//  AS EACH PROCESS IS IN AT MOST ONE QUEUE AT A TIME, IT NEEDS ONLY A SINGLE
+//  PAIR OF LINKS, AND IT MAY BE REMOVED FROM ANYWHERE IN ITS QUEUE IN O(1).
+
+#define FOREACH_IN_QUEUE(sim, q, p) \
+            for(int p=(q).head, next_##p ; \
+                p != UNKNOWN && (next_##p = (sim)->processes[p].next, true) ; p=next_##p)
+
+void init_queue(struct queue *q)
+{
+    q->head     = UNKNOWN;
+    q->tail     = UNKNOWN;
+    q->n        = 0;
+}
+
+void append_to_queue(struct simulation *sim, struct queue *q, int proc)
+{
+    struct process *processes   = sim->processes;
+
+    processes[proc].next    = UNKNOWN;
+    processes[proc].prev    = q->tail;
+
+    if(q->tail == UNKNOWN) {
+        q->head                     = proc;
+    }
+    else {
+        processes[q->tail].next     = proc;
+    }
+    q->tail     = proc;
+    ++q->n;
+}
+
+void remove_from_queue(struct simulation *sim, struct queue *q, int proc)
+{
+    struct process *processes   = sim->processes;
+    int next    = processes[proc].next;
+    int prev    = processes[proc].prev;
+
+    if(prev == UNKNOWN) {
+        q->head                 = next;
+    }
+    else {
+        processes[prev].next    = next;
+    }
+    if(next == UNKNOWN) {
+        q->tail                 = prev;
+    }
+    else {
+        processes[next].prev    = prev;
+    }
+    --q->n;
+}
+
+//  MOVE ALL PROCESSES OF QUEUE from TO THE END OF QUEUE to
+void append_queue_to_queue(struct simulation *sim, struct queue *to, struct queue *from)
+{
+    if(from->n > 0) {
+        if(to->tail == UNKNOWN) {
+            to->head                        = from->head;
+        }
+        else {
+            sim->processes[to->tail].next   = from->head;
+            sim->processes[from->head].prev = to->tail;
+        }
+        to->tail    = from->tail;
+        to->n      += from->n;
+        init_queue(from);
+    }
+}
+
+int dequeue(struct simulation *sim, struct queue *q)
+{
+    int proc    = q->head;
+
+    if(proc != UNKNOWN) {
+        remove_from_queue(sim, q, proc);
+    }
+    return proc;
+}
+
+//  ----------------------------------------------------------------------
+
+//  EACH PROCESS ACCUMULATES THE usecs IT SPENDS IN EACH STATE, AS IT CHANGES
+//  STATE.  ITS LATENCIES ARE ADDED TO THE SIMULATION'S HISTOGRAMS AS THEY
+//  BECOME KNOWN, SO NOTHING IS KEPT ONCE THE PROCESS HAS EXITED.
+
+void init_metrics(struct simulation *sim)
+{
+    sim->metrics        = calloc(MS_NMETRICS, sizeof sim->metrics[0]);
+    sim->device_metrics = calloc(sim->w->ndevices*MS_NDEVICE_METRICS + 1, sizeof sim->device_metrics[0]);
+
+    if(sim->metrics == NULL || sim->device_metrics == NULL) {
+        fail(&sim->failure, "ERROR - out of memory for metrics");
+    }
+}
+
+void enter_state(struct simulation *sim, int proc, int state)
+{
+    struct process *p   = &sim->processes[proc];
+    struct history *h   = &sim->histories[proc];
+    usecs_t spent       = sim->USECS_SINCE_REBOOT - p->state_since;
+
+    h->time_in_state[p->state] += spent;
+    if(p->state == STATE_READY) {
+        histogram_record(&sim->metrics[MS_METRIC_SCHEDULING], spent);
+    }
+    if(state == STATE_RUNNING && !h->has_run) {
+        histogram_record(&sim->metrics[MS_METRIC_RESPONSE], sim->USECS_SINCE_REBOOT - h->spawned_at);
+        h->has_run  = true;
+    }
+    p->state        = state;
+    p->state_since  = sim->USECS_SINCE_REBOOT;
+}
+
+void process_has_exited(struct simulation *sim, int proc)
+{
+    struct history *h   = &sim->histories[proc];
+
+    histogram_record(&sim->metrics[MS_METRIC_TURNAROUND], sim->USECS_SINCE_REBOOT - h->spawned_at);
+    histogram_record(&sim->metrics[MS_METRIC_READY],      h->time_in_state[STATE_READY]);
+    histogram_record(&sim->metrics[MS_METRIC_BLOCKED],    h->time_in_state[STATE_IO_BLOCKED]);
+    histogram_record(&sim->metrics[MS_METRIC_SLEEPING],   h->time_in_state[STATE_SLEEPING]);
+    histogram_record(&sim->metrics[MS_METRIC_WAITING],    h->time_in_state[STATE_WAITING]);
+}
+
+//  A SYSCALL'S FIXED VALUE, OR ONE DRAWN BY THE PROCESS FROM ITS DISTRIBUTION
+long long syscall_value(struct simulation *sim, int proc, long long value, int distribution)
+{
+    struct process *p   = &sim->processes[proc];
+
+    if(distribution == UNKNOWN) {
+        return value;
+    }
+    return draw_from_distribution(sim->w, distribution, p->random_key, &p->ndraws);
+}
+
+//  DETERMINE WHEN (IN usecs ONCPU) THE PROCESS WILL ISSUE ITS NEXT SYSCALL.
+//  A FIXED TIME ALREADY PASSED (AFTER EARLIER DRAWN TIMES) IS ISSUED AT ONCE.
+void find_syscall_at(struct simulation *sim, int proc)
+{
+    struct process *p       = &sim->processes[proc];
+
+    if(p->next_syscall == p->end_syscall) {
+        p->syscall_at   = NO_MORE_SYSCALLS;
+    }
+    else {
+        struct syscall *sc  = &sim->w->all_syscalls[p->next_syscall];
+
+        if(sc->when_distribution != UNKNOWN) {
+            p->syscall_at   = p->time_on_CPU + syscall_value(sim, proc, 0, sc->when_distribution);
+        }
+        else {
+            p->syscall_at   = (sc->when > p->time_on_CPU) ? sc->when : p->time_on_CPU;
+        }
+    }
+}
+
+//  SPAWN THE REQUESTED COMMAND, ADD TO THE READY QUEUE, ADD PARENT TO READY
+void spawn_process(struct simulation *sim, int command, int parent)
+{
+    int p                   = allocate_process_slot(sim);
+    struct process *proc    = &sim->processes[p];
+
+    proc->state             = STATE_NEW;
+    proc->pid               = sim->next_pid++;
+    ++sim->nspawned;
+    proc->parent            = parent;
+    proc->ppid              = (parent == UNKNOWN) ? UNKNOWN : sim->processes[parent].pid;
+    proc->command           = command;
+    proc->next_syscall      = sim->w->commands[command].first_syscall;
+    proc->end_syscall       = proc->next_syscall + sim->w->commands[command].nsyscalls;
+    proc->time_on_CPU       = 0;
+    proc->state_since       = sim->USECS_SINCE_REBOOT;
+
+    struct history *h       = &sim->histories[p];
+
+    h->spawned_at           = sim->USECS_SINCE_REBOOT;
+    memset(h->time_in_state, 0, sizeof h->time_in_state);
+    h->has_run              = false;
+
+    proc->level             = 0;
+    proc->epoch             = 0;
+    proc->vruntime_lag      = 0;
+
+//  A CHILD'S STREAM IS KEYED BY A VALUE DRAWN FROM ITS PARENT'S,
+//  AND THAT OF A PROCESS WITHOUT A PARENT BY THE ORDER IN WHICH IT ARRIVED
+    if(parent == UNKNOWN) {
+        proc->random_key    = mix64(sim->seed ^ mix64(sim->narrived));
+    }
+    else {
+        struct process *pp  = &sim->processes[parent];
+
+        proc->random_key    = mix64(pp->random_key ^ mix64(pp->ndraws++));
+    }
+    proc->ndraws            = 0;
+    find_syscall_at(sim, p);
+
+    proc->nchildren         = 0;
+    ++sim->nprocesses;
+
+    TRACE(sim, EVENT_SPAWN, proc->pid, command, 0, 0, 0);
+    append_to_READY_queue(sim, p, STATE_NEW);
+    TRACE(sim, EVENT_NO_TRANSITION, UNKNOWN, UNKNOWN, 0, 0, 0);
+    trace_flush(sim, UNKNOWN);
+}
+
+void exit_process(struct simulation *sim, int proc_on_CPU)
+{
+    struct process *processes   = sim->processes;
+
+    TRACE(sim, EVENT_EXIT, processes[proc_on_CPU].pid, UNKNOWN, 0, 0, 0);
+    TRACE(sim, EVENT_NO_TRANSITION, UNKNOWN, UNKNOWN, 0, 0, 0);
+    trace_flush(sim, proc_on_CPU);
+
+//  PIDS ARE 64-BIT AND NEVER REUSED, SO IF THE PARENT'S SLOT STILL HOLDS THE
+//  SAME pid, THE PARENT IS STILL RUNNING (AND THE SLOT HAS NOT BEEN RECYCLED)
+    int parent  = processes[proc_on_CPU].parent;
+
+    if(parent != UNKNOWN && processes[parent].pid == processes[proc_on_CPU].ppid) {
+        --processes[parent].nchildren;
+        child_has_exited(sim, parent);
+    }
+    enter_state(sim, proc_on_CPU, STATE_TERMINATED);
+    process_has_exited(sim, proc_on_CPU);
+    free_process_slot(sim, proc_on_CPU);                        // now unused
+    --sim->nprocesses;
+}
+
+//  ----------------------------------------------------------------------
+
+//  A BINARY MIN-HEAP OF INDICES (OF PROCESSES OR DEVICES), ORDERED BY THEIR
+//  key, THEN BY THEIR seq.  ITS OWNER KEEPS ITS SIZE, n.
+
+struct keyed {
+    int         index;
+    long long   key;
+    long long   seq;
+};
+
+bool keyed_before(const struct keyed *a, const struct keyed *b)
+{
+    return a->key < b->key || (a->key == b->key && a->seq < b->seq);
+}
+
+//  ADD A NEW ENTRY TO A HEAP OF n ENTRIES
+void push_keyed(struct failure *f, struct keyed **heapp, int *capacity, int n, struct keyed new)
+{
+    *heapp  = grow_table(f, *heapp, capacity, n+1, sizeof (*heapp)[0]);
+    struct keyed    *heap   = *heapp;
+
+//  SIFT THE NEW ENTRY UP FROM THE BOTTOM OF THE HEAP
+    int e   = n;
+    while(e > 0 && keyed_before(&new, &heap[(e-1)/2])) {
+        heap[e] = heap[(e-1)/2];
+        e       = (e-1)/2;
+    }
+    heap[e] = new;
+}
+
+//  REMOVE THE ENTRY WITH THE LOWEST key FROM THE TOP OF A HEAP OF n ENTRIES
+struct keyed pop_keyed(struct keyed *heap, int n)
+{
+    struct keyed    top     = heap[0];
+    struct keyed    last    = heap[--n];
+
+//  SIFT THE LAST ENTRY DOWN FROM THE TOP OF THE HEAP
+    int e   = 0;
+    for(;;) {
+        int child   = 2*e + 1;
+
+        if(child >= n) {
+            break;
+        }
+        if(child+1 < n && keyed_before(&heap[child+1], &heap[child])) {
+            ++child;
+        }
+        if(!keyed_before(&heap[child], &last)) {
+            break;
+        }
+        heap[e] = heap[child];
+        e       = child;
+    }
+    heap[e] = last;
+    return top;
+}
+
+//  ----------------------------------------------------------------------
+
+//  AN ARRAY OF STRUCTURES AND FUNCTIONS TO MANAGE THE SYSTEM'S I/O DEVICES.
+//  EACH SIMULATION HAS ITS OWN QUEUE OF PROCESSES BLOCKED ON EACH DEVICE.
+//  EACH DEVICE TRANSFERS OVER ONE DATABUS, NAMED BY ITS sysconfig LINE.
+
+struct device {
+    int         symbol;                     // index into symbols[]
+    long long   read_speed;                 // Bps
+    long long   write_speed;                // Bps
+    int         bus;                        // the databus it transfers over
+};
+
+#define FOREACH_DEVICE(w)   for(int d=0 ; d<(w)->ndevices ; ++d)
+#define DEVICE_NAME(w, d)   SYMBOL_NAME(w, (w)->devices[d].symbol)
+
+//  ----------------------------------------------------------------------
+
+//  THE SYSTEM HAS ONE OR MORE DATABUSES (OR DMA CHANNELS), EACH TRANSFERRING
+//  FOR ONE DEVICE AT A TIME, SO TRANSFERS OVER DIFFERENT BUSES OVERLAP.
+//  EACH BUS KEEPS A HEAP OF ITS DEVICES THAT HAVE PENDING REQUESTS (AND ARE
+//  NOT TRANSFERRING), KEYED BY ITS ARBITRATION POLICY ON THE REQUEST AT THE
+//  HEAD OF EACH DEVICE'S QUEUE, SO THE NEXT DEVICE IS FOUND IN O(log n).
+
+#define DEFAULT_BUSES                   1
+
+#define ARBITRATE_FASTEST               0       // fastest for the request's direction
+#define ARBITRATE_FIFO                  1       // oldest request first
+#define ARBITRATE_DEADLINE              2       // earliest deadline first
+
+char *arbitration_policies[] = {
+    "fastest", "fifo", "deadline", NULL
+};
+
+//  THE DEADLINES OF REQUESTS, AFTER BEING BLOCKED, IN usecs
+#define READ_DEADLINE                   500
+#define WRITE_DEADLINE                  5000
+
+struct bus {
+    int         device;                     // transferring, or UNKNOWN
+    usecs_t     inuse_until;
+    int         nbatch;                     // its requests yet to complete
+    struct keyed    *pending;               // devices waiting for the bus
+    int         npending;
+    int         pending_capacity;
+};
+
+#define FOREACH_BUS(sim)    for(int b=0 ; b<(sim)->nbuses ; ++b)
+
+int find_arbitration_byname(const char name[], int length)
+{
+    for(int a=0 ; arbitration_policies[a] != NULL ; ++a) {
+        if(word_is(name, length, arbitration_policies[a])) {
+            return a;
+        }
+    }
+    return UNKNOWN;
+}
+
+void init_devices_and_IO_BLOCKED_queues(struct simulation *sim)
+{
+    int capacity    = 0;
+
+    sim->IO_BLOCKED_queues  = grow_table(&sim->failure, NULL, &capacity,
+                                    sim->w->ndevices, sizeof sim->IO_BLOCKED_queues[0]);
+    FOREACH_DEVICE(sim->w) {
+        init_queue(&sim->IO_BLOCKED_queues[d]);
+
+        if(sim->w->devices[d].bus < 0 || sim->w->devices[d].bus >= sim->nbuses) {
+            fail(&sim->failure, "ERROR - device '%s' is on bus %i, but there are only %i buses",
+                    DEVICE_NAME(sim->w, d), sim->w->devices[d].bus, sim->nbuses);
+        }
+    }
+
+//  NO DEVICE YET OWNS ANY DATABUS
+    capacity        = 0;
+    sim->buses      = grow_table(&sim->failure, NULL, &capacity, sim->nbuses, sizeof sim->buses[0]);
+    FOREACH_BUS(sim) {
+        sim->buses[b].device            = UNKNOWN;
+        sim->buses[b].inuse_until       = UNKNOWN;
+        sim->buses[b].nbatch            = 0;
+        sim->buses[b].pending           = NULL;
+        sim->buses[b].npending          = 0;
+        sim->buses[b].pending_capacity  = 0;
+    }
+    sim->nblocked   = 0;
+    sim->ncoalesced = 0;
+}
+
+void add_device(struct workload *w, const char name[], int length,
+                long long read_speed, long long write_speed, int bus)
+{
+    w->devices  = grow_table(&w->failure, w->devices, &w->devices_capacity,
+                                w->ndevices+1, sizeof w->devices[0]);
+
+    int sym = intern(w, name, length);
+
+    if(w->symbols[sym].device == UNKNOWN) {     // first definition is used
+        w->symbols[sym].device  = w->ndevices;
+    }
+    w->devices[w->ndevices].symbol        = sym;
+    w->devices[w->ndevices].read_speed    = read_speed;
+    w->devices[w->ndevices].write_speed   = write_speed;
+    w->devices[w->ndevices].bus           = bus;
+    ++w->ndevices;
+}
+
+//  THE SPEED OF THE GIVEN DEVICE, IN THE DIRECTION OF THE GIVEN SYSCALL
+long long device_speed(const struct workload *w, int device, int syscall)
+{
+    return (syscall == SYS_READ) ? w->devices[device].read_speed : w->devices[device].write_speed;
+}
+
+//  A DEVICE WITH PENDING REQUESTS JOINS ITS BUS'S HEAP, KEYED ON ITS HEAD
+//  REQUEST.  TIES GO TO THE LOWEST-NUMBERED DEVICE.
+void device_wants_bus(struct simulation *sim, int device)
+{
+    struct process  *head   = &sim->processes[sim->IO_BLOCKED_queues[device].head];
+    struct bus      *bus    = &sim->buses[sim->w->devices[device].bus];
+    struct keyed    new     = { device, 0, device };
+
+    switch (sim->arbitration) {
+        case ARBITRATE_FASTEST:
+            new.key = -device_speed(sim->w, device, head->io_syscall);
+            break;
+
+        case ARBITRATE_FIFO:
+            new.key = head->state_since;            // when it became blocked
+            break;
+
+        case ARBITRATE_DEADLINE:
+            new.key = head->state_since + ((head->io_syscall == SYS_READ) ? READ_DEADLINE : WRITE_DEADLINE);
+            break;
+    }
+    push_keyed(&sim->failure, &bus->pending, &bus->pending_capacity, bus->npending, new);
+    ++bus->npending;
+}
+
+void append_to_IO_BLOCKED_queue(struct simulation *sim, int proc_on_CPU, int syscall,
+                                int device, long long nbytes)
+{
+    TRACE(sim, EVENT_BLOCKED, sim->processes[proc_on_CPU].pid, syscall, nbytes, 0, 0);
+    enter_state(sim, proc_on_CPU, STATE_IO_BLOCKED);
+    advance_time(sim, TIME_CORE_STATE_TRANSITIONS);
+
+    sim->processes[proc_on_CPU].io_syscall  = syscall;
+    sim->processes[proc_on_CPU].io_nbytes   = nbytes;
+    append_to_queue(sim, &sim->IO_BLOCKED_queues[device], proc_on_CPU);
+    ++sim->nblocked;
+
+//  A DEVICE WITH OTHER REQUESTS IS ALREADY WAITING FOR, OR USING, ITS BUS
+    if(sim->IO_BLOCKED_queues[device].n == 1) {
+        device_wants_bus(sim, device);
+    }
+}
+
+//  WITH COALESCING, A DEVICE ACQUIRING ITS BUS ALSO TAKES THE REQUESTS BEHIND
+//  ITS HEAD REQUEST, IN THE SAME DIRECTION, UP TO coalesce REQUESTS AND
+//  coalescebytes BYTES (EITHER 0 IF UNLIMITED).  EACH TRANSFERS IN TURN,
+//  WITHOUT ACQUIRING THE BUS AGAIN, AND ITS PROCESS IS UNBLOCKED AS IT COMPLETES.
+int coalesce_batch(struct simulation *sim, int device)
+{
+    struct process  *processes  = sim->processes;
+    int             head        = sim->IO_BLOCKED_queues[device].head;
+    int             n           = 1;
+    long long       nbytes      = processes[head].io_nbytes;
+
+    if(sim->coalesce_count == 0 && sim->coalesce_bytes == 0) {
+        return n;
+    }
+    for(int p=processes[head].next ; p != UNKNOWN ; p=processes[p].next) {
+        if(processes[p].io_syscall != processes[head].io_syscall ||
+           (sim->coalesce_count > 0 && n == sim->coalesce_count) ||
+           (sim->coalesce_bytes > 0 && nbytes + processes[p].io_nbytes > sim->coalesce_bytes)) {
+            break;
+        }
+        ++n;
+        nbytes  += processes[p].io_nbytes;
+    }
+    return n;
+}
+
+//  THE BUS'S DEVICE STARTS TO TRANSFER ITS HEAD REQUEST, HAVING JUST ACQUIRED
+//  THE BUS, OR CONTINUING A BATCH OF COALESCED REQUESTS
+void start_transfer(struct simulation *sim, int b, bool acquired)
+{
+    struct bus  *bus        = &sim->buses[b];
+    int         device      = bus->device;
+
+//  DETERMINE HOW LONG THIS I/O WILL TAKE
+    int proc                = sim->IO_BLOCKED_queues[device].head;
+    int s                   = sim->processes[proc].io_syscall;
+    long long nbytes        = sim->processes[proc].io_nbytes;
+    long long speed         = device_speed(sim->w, device, s);
+
+    usecs_t usecs           = ceil(1000000.0*(double)nbytes / (double)speed);
+    usecs_t acquiring       = acquired ? TIME_ACQUIRE_BUS : 0;
+    bus->inuse_until        = sim->USECS_SINCE_REBOOT + acquiring + usecs;
+
+//  THE PROCESS HAS WAITED FOR THE DATABUS SINCE IT BECAME BLOCKED
+    struct histogram *metrics   = &sim->device_metrics[device*MS_NDEVICE_METRICS];
+
+    histogram_record(&metrics[MS_DEVICE_BUS_WAIT], sim->USECS_SINCE_REBOOT - sim->processes[proc].state_since);
+    histogram_record(&metrics[MS_DEVICE_TRANSFER], acquiring + usecs);
+
+    TRACE(sim, acquired ? EVENT_ACQUIRE_BUS : EVENT_COALESCED, sim->processes[proc].pid,
+                device, s, nbytes, usecs);
+    trace_flush(sim, UNKNOWN);
+}
+
+//  AS EACH DATABUS TRANSFERS FOR ONE PROCESS, ONE PROCESS PER BUS MAY BE UNBLOCKED
+void unblock_completed_IO(struct simulation *sim)
+{
+    PROFILE_BEGIN();
+    PROFILE_COUNT(&sim->profile, PHASE_IO_COMPLETE, sim->nbuses);
+
+    FOREACH_BUS(sim) {
+        struct bus  *bus    = &sim->buses[b];
+        int         device  = bus->device;
+
+        if(device != UNKNOWN && bus->inuse_until <= sim->USECS_SINCE_REBOOT) {
+            int proc    = sim->IO_BLOCKED_queues[device].head;
+            int s       = sim->processes[proc].io_syscall;
+
+            TRACE(sim, EVENT_IO_COMPLETE, sim->processes[proc].pid, device, s, 0, 0);
+            dequeue(sim, &sim->IO_BLOCKED_queues[device]);
+
+//  THE NEXT COALESCED REQUEST KEEPS THE BUS, OR THE BUS IS RELEASED
+            if(--bus->nbatch > 0) {
+                trace_flush(sim, UNKNOWN);
+                start_transfer(sim, b, false);
+                ++sim->ncoalesced;
+            }
+            else {
+                TRACE(sim, EVENT_DATABUS_IDLE, UNKNOWN, b, 0, 0, 0);
+                trace_flush(sim, UNKNOWN);
+
+                bus->device         = UNKNOWN;
+                bus->inuse_until    = UNKNOWN;
+                if(sim->IO_BLOCKED_queues[device].n > 0) {
+                    device_wants_bus(sim, device);
+                }
+            }
+
+            append_to_READY_queue(sim, proc, STATE_IO_BLOCKED);
+            advance_time(sim, TIME_CORE_STATE_TRANSITIONS);
+            --sim->nblocked;
+        }
+    }
+    PROFILE_END(&sim->profile, PHASE_IO_COMPLETE);
+}
+
+//  CAN A TRANSFER START NOW, OVER ANY IDLE BUS?
+bool can_start_IO(struct simulation *sim)
+{
+    FOREACH_BUS(sim) {
+        if(sim->buses[b].device == UNKNOWN && sim->buses[b].npending > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//  WHEN THE NEXT TRANSFER WILL COMPLETE, OR LLONG_MAX IF NONE IS UNDER WAY
+usecs_t next_IO_completion(struct simulation *sim)
+{
+    usecs_t next    = LLONG_MAX;
+
+    FOREACH_BUS(sim) {
+        if(sim->buses[b].device != UNKNOWN && sim->buses[b].inuse_until < next) {
+            next    = sim->buses[b].inuse_until;
+        }
+    }
+    return next;
+}
+
+void start_pending_IO(struct simulation *sim)
+{
+    PROFILE_BEGIN();
+
+//  ON EACH BUS THAT NO DEVICE CURRENTLY OWNS (IS USING), AND OTHERS WISH TO
+    FOREACH_BUS(sim) {
+        struct bus  *bus    = &sim->buses[b];
+
+        if(bus->device != UNKNOWN || bus->npending == 0) {
+            continue;
+        }
+        int device          = pop_keyed(bus->pending, bus->npending--).index;
+
+        bus->device         = device;
+        bus->nbatch         = coalesce_batch(sim, device);
+        start_transfer(sim, b, true);
+        PROFILE_COUNT(&sim->profile, PHASE_IO_START, 1);
+    }
+    PROFILE_END(&sim->profile, PHASE_IO_START);
+}
+
+int find_device_byname(const struct workload *w, const char name[], int length)
+{
+    int sym = find_symbol(w, name, length);
+
+    return (sym == UNKNOWN) ? UNKNOWN : w->symbols[sym].device;
+}
+
+//  ----------------------------------------------------------------------
+
+//  AN ARRAY OF STRUCTURES AND FUNCTIONS TO MANAGE THE SYSTEM'S CPU CORES.
+//  EACH CORE HAS ITS OWN READY QUEUE AND TIMEQUANTUM, AND PROCESSES BECOMING
+//  READY JOIN THE QUEUE OF THE CORE THAT MADE THEM READY.  AN IDLE CORE WITH
+//  AN EMPTY READY QUEUE MAY STEAL A READY PROCESS FROM ANOTHER CORE.
+
+#define DEFAULT_CORES                   1
+#define DEFAULT_TIME_STEAL              10
+
+#define STEAL_NONE                      0
+#define STEAL_BUSIEST                   1       // from the longest queue
+#define STEAL_NEIGHBOUR                 2       // from the next busy core
+
+char *steal_policies[] = {
+    "none", "busiest", "neighbour", NULL
+};
+
+#define MLFQ_LEVELS                     4
+
+struct core {
+    int         proc_on_CPU;                // index into processes[], or UNKNOWN
+    usecs_t     timequantum_expires;
+    usecs_t     next_usec;                  // when this core next executes
+
+//  THE READY QUEUE IS EITHER FIFO (ONE PER MLFQ LEVEL) OR A HEAP, AS THE
+//  SCHEDULER REQUIRES
+    int         nready;                     // #processes in its READY queue
+    struct queue    READY_queues[MLFQ_LEVELS];
+    struct keyed    *READY_heap;
+    int         READY_heap_capacity;
+    usecs_t     min_vruntime;               // of all dequeued, for CFS
+    long long   mlfq_epoch;                 // when MLFQ last boosted its levels
+
+    usecs_t     time_on_CPU;                // usecs spent computing
+    usecs_t     time_switching;             // usecs spent context switching
+    int         ncontext_switches;
+    int         nsteals;
+};
+
+#define FOREACH_CORE(sim)   for(int k=0 ; k<(sim)->ncores ; ++k)
+
+//  ----------------------------------------------------------------------
+
+//  EACH CORE'S READY QUEUE IS ORDERED BY THE SCHEDULER NAMED IN sysconfig.
+//  A SCHEDULER DECIDES WHERE A PROCESS JOINS THE QUEUE, WHICH PROCESS LEAVES
+//  IT NEXT, WHICH PROCESS ANOTHER CORE MAY STEAL, HOW LONG A PROCESS MAY
+//  RUN, AND WHAT HAPPENS WHEN THAT TIMEQUANTUM EXPIRES.  ALL ENQUEUE AND
+//  DEQUEUE OPERATIONS ARE O(1) OR O(log n).
+
+#define SCHEDULER_RR                    0       // round-robin, FIFO
+#define SCHEDULER_MLFQ                  1       // multi-level feedback queues
+#define SCHEDULER_CFS                   2       // least virtual runtime first
+#define SCHEDULER_SJF                   3       // shortest next CPU burst first
+#define SCHEDULER_PRIORITY              4       // static priority, with aging
+
+//  MLFQ LEVEL k HAS A TIMEQUANTUM OF timequantum << k.  A PROCESS WHOSE
+//  TIMEQUANTUM EXPIRES DROPS ONE LEVEL, AND ALL ARE PERIODICALLY BOOSTED BACK.
+#define MLFQ_BOOST                      20      // every 20 timequantums
+
+//  CFS DIVIDES THE timequantum AMONG A CORE'S READY PROCESSES, DOWN TO
+#define CFS_MIN_GRANULARITY             8       // 1/8 of the timequantum
+
+//  A PROCESS GAINS ONE LEVEL OF PRIORITY FOR EACH PRIORITY_AGING usecs READY
+#define PRIORITY_AGING                  1000
+
+//  SJF IS NOT PREEMPTIVE - A PROCESS RUNS UNTIL ITS NEXT SYSTEM-CALL
+#define NO_TIMEQUANTUM                  (LLONG_MAX/4)
+
+struct scheduler {
+    char        *name;
+    void        (*enqueue)(struct simulation *sim, struct core *core, int proc);
+    int         (*dequeue)(struct simulation *sim, struct core *core);
+    int         (*steal)(struct simulation *sim, struct core *victim, struct core *thief);
+    usecs_t     (*timequantum)(struct simulation *sim, struct core *core, int proc);
+    void        (*expired)(struct simulation *sim, int proc);   // or NULL
+};
+
+//  ROUND-ROBIN, THE ORIGINAL SCHEDULER, KEEPS A SINGLE FIFO QUEUE
+
+void rr_enqueue(struct simulation *sim, struct core *core, int proc)
+{
+    append_to_queue(sim, &core->READY_queues[0], proc);
+}
+
+int rr_dequeue(struct simulation *sim, struct core *core)
+{
+    return dequeue(sim, &core->READY_queues[0]);        // head of queue
+}
+
+int rr_steal(struct simulation *sim, struct core *victim, struct core *thief)
+{
+    int proc    = victim->READY_queues[0].tail;
+
+    remove_from_queue(sim, &victim->READY_queues[0], proc);
+    append_to_queue(sim, &thief->READY_queues[0], proc);
+    return proc;
+}
+
+usecs_t rr_timequantum(struct simulation *sim, struct core *core, int proc)
+{
+    (void)core; (void)proc;
+    return sim->timequantum;
+}
+
+//  MLFQ KEEPS A FIFO QUEUE PER LEVEL.  BOOSTING ALL LEVELS BACK TO LEVEL 0
+//  APPENDS EACH LOWER QUEUE TO IT, IN O(1) PER LEVEL.  A PROCESS NOT READY
+//  WHEN ITS CORE WAS BOOSTED RETURNS TO LEVEL 0 WHEN IT NEXT BECOMES READY.
+
+long long mlfq_epoch(struct simulation *sim)
+{
+    usecs_t interval    = MLFQ_BOOST * sim->timequantum;
+
+    return sim->USECS_SINCE_REBOOT / ((interval > 0) ? interval : 1);
+}
+
+void mlfq_enqueue(struct simulation *sim, struct core *core, int proc)
+{
+    struct process *p   = &sim->processes[proc];
+
+    if(p->epoch < mlfq_epoch(sim)) {
+        p->level    = 0;
+    }
+    append_to_queue(sim, &core->READY_queues[p->level], proc);
+}
+
+int mlfq_dequeue(struct simulation *sim, struct core *core)
+{
+    long long epoch = mlfq_epoch(sim);
+
+    if(core->mlfq_epoch < epoch) {
+        for(int l=1 ; l<MLFQ_LEVELS ; ++l) {
+            append_queue_to_queue(sim, &core->READY_queues[0], &core->READY_queues[l]);
+        }
+        core->mlfq_epoch    = epoch;
+    }
+    for(int l=0 ; l<MLFQ_LEVELS ; ++l) {
+        if(core->READY_queues[l].n > 0) {
+            int proc                        = dequeue(sim, &core->READY_queues[l]);
+
+            sim->processes[proc].level      = l;
+            sim->processes[proc].epoch      = epoch;
+            return proc;
+        }
+    }
+    return UNKNOWN;
+}
+
+//  STEAL THE LAST PROCESS OF THE LOWEST NON-EMPTY LEVEL
+int mlfq_steal(struct simulation *sim, struct core *victim, struct core *thief)
+{
+    for(int l=MLFQ_LEVELS-1 ; l>=0 ; --l) {
+        if(victim->READY_queues[l].n > 0) {
+            int proc    = victim->READY_queues[l].tail;
+
+            remove_from_queue(sim, &victim->READY_queues[l], proc);
+            append_to_queue(sim, &thief->READY_queues[l], proc);
+            return proc;
+        }
+    }
+    return UNKNOWN;
+}
+
+usecs_t mlfq_timequantum(struct simulation *sim, struct core *core, int proc)
+{
+    (void)core;
+    return sim->timequantum << sim->processes[proc].level;
+}
+
+void mlfq_expired(struct simulation *sim, int proc)
+{
+    if(sim->processes[proc].level < MLFQ_LEVELS-1) {
+        ++sim->processes[proc].level;
+    }
+}
+
+//  THE OTHER SCHEDULERS KEEP A BINARY MIN-HEAP, DIFFERING ONLY IN THEIR keys
+
+void heap_enqueue(struct simulation *sim, struct core *core, int proc, long long key)
+{
+    struct keyed    new = { proc, key, sim->nenqueued++ };
+
+    push_keyed(&sim->failure, &core->READY_heap, &core->READY_heap_capacity, core->nready, new);
+}
+
+int heap_dequeue(struct simulation *sim, struct core *core)
+{
+    (void)sim;
+    return pop_keyed(core->READY_heap, core->nready).index;
+}
+
+//  STEAL THE HEAP'S LAST LEAF, WHICH IS NEVER ITS MOST URGENT PROCESS
+//  (UNLESS IT IS ITS ONLY ONE), KEEPING ITS key
+int heap_steal(struct simulation *sim, struct core *victim, struct core *thief)
+{
+    struct keyed    stolen  = victim->READY_heap[victim->nready-1];
+
+    push_keyed(&sim->failure, &thief->READY_heap, &thief->READY_heap_capacity, thief->nready, stolen);
+    return stolen.index;
+}
+
+//  A PROCESS'S VIRTUAL RUNTIME IS ITS time_on_CPU, BUT NEVER FALLS BEHIND THE
+//  CORE'S min_vruntime, SO THAT A LONG SLEEPER CANNOT MONOPOLIZE THE CORE
+void cfs_enqueue(struct simulation *sim, struct core *core, int proc)
+{
+    struct process *p   = &sim->processes[proc];
+    usecs_t vruntime    = p->time_on_CPU + p->vruntime_lag;
+
+    if(vruntime < core->min_vruntime) {
+        p->vruntime_lag += core->min_vruntime - vruntime;
+        vruntime        = core->min_vruntime;
+    }
+    heap_enqueue(sim, core, proc, vruntime);
+}
+
+int cfs_dequeue(struct simulation *sim, struct core *core)
+{
+    struct keyed    next    = pop_keyed(core->READY_heap, core->nready);
+
+    (void)sim;
+    if(next.key > core->min_vruntime) {
+        core->min_vruntime  = next.key;
+    }
+    return next.index;
+}
+
+usecs_t cfs_timequantum(struct simulation *sim, struct core *core, int proc)
+{
+    usecs_t slice   = sim->timequantum / (core->nready+1);
+    usecs_t least   = sim->timequantum / CFS_MIN_GRANULARITY;
+
+    (void)proc;
+    return (slice > least) ? slice : (least > 0) ? least : 1;
+}
+
+//  SJF ORDERS BY THE usecs UNTIL EACH PROCESS'S NEXT SYSTEM-CALL
+void sjf_enqueue(struct simulation *sim, struct core *core, int proc)
+{
+    struct process *p       = &sim->processes[proc];
+    long long burst         = LLONG_MAX;
+
+    if(p->syscall_at != NO_MORE_SYSCALLS) {
+        burst   = p->syscall_at - p->time_on_CPU;
+    }
+    heap_enqueue(sim, core, proc, burst);
+}
+
+usecs_t sjf_timequantum(struct simulation *sim, struct core *core, int proc)
+{
+    (void)sim; (void)core; (void)proc;
+    return NO_TIMEQUANTUM;
+}
+
+//  A PROCESS'S key IS WHEN IT BECAME READY, DELAYED BY ITS COMMAND'S
+//  PRIORITY (LOWER IS MORE URGENT), SO EVERY PRIORITY_AGING usecs THAT IT
+//  WAITS RAISES IT ABOVE PROCESSES OF ONE MORE LEVEL THAT BECOME READY
+void priority_enqueue(struct simulation *sim, struct core *core, int proc)
+{
+    int priority    = sim->w->commands[sim->processes[proc].command].priority;
+
+    heap_enqueue(sim, core, proc, sim->USECS_SINCE_REBOOT + (long long)priority*PRIORITY_AGING);
+}
+
+struct scheduler schedulers[] = {
+    { "rr",       rr_enqueue,       rr_dequeue,     rr_steal,   rr_timequantum,   NULL },
+    { "mlfq",     mlfq_enqueue,     mlfq_dequeue,   mlfq_steal, mlfq_timequantum, mlfq_expired },
+    { "cfs",      cfs_enqueue,      cfs_dequeue,    heap_steal, cfs_timequantum,  NULL },
+    { "sjf",      sjf_enqueue,      heap_dequeue,   heap_steal, sjf_timequantum,  NULL },
+    { "priority", priority_enqueue, heap_dequeue,   heap_steal, rr_timequantum,   NULL },
+    { NULL }
+};
+
+int find_scheduler_byname(const char name[], int length)
+{
+    for(int s=0 ; schedulers[s].name != NULL ; ++s) {
+        if(word_is(name, length, schedulers[s].name)) {
+            return s;
+        }
+    }
+    return UNKNOWN;
+}
+
+//  ----------------------------------------------------------------------
+
+void init_cores(struct simulation *sim)
+{
+    sim->cores  = grow_table(&sim->failure, sim->cores, &sim->cores_capacity,
+                                sim->ncores, sizeof sim->cores[0]);
+    FOREACH_CORE(sim) {
+        struct core *core           = &sim->cores[k];
+
+        core->proc_on_CPU           = UNKNOWN;
+        core->timequantum_expires   = UNKNOWN;
+        core->next_usec             = 0;
+
+        core->nready                = 0;
+        for(int l=0 ; l<MLFQ_LEVELS ; ++l) {
+            init_queue(&core->READY_queues[l]);
+        }
+        core->READY_heap            = NULL;
+        core->READY_heap_capacity   = 0;
+        core->min_vruntime          = 0;
+        core->mlfq_epoch            = 0;
+
+        core->time_on_CPU           = 0;
+        core->time_switching        = 0;
+        core->ncontext_switches     = 0;
+        core->nsteals               = 0;
+    }
+    sim->current_core   = 0;
+    sim->nready         = 0;
+    sim->nenqueued      = 0;
+}
+
+void append_to_READY_queue(struct simulation *sim, int proc, int came_from)
+{
+    struct core *core   = &sim->cores[sim->current_core];
+    PROFILE_BEGIN();
+
+    TRACE(sim, EVENT_READY, sim->processes[proc].pid, came_from, 0, 0, 0);
+    enter_state(sim, proc, STATE_READY);
+    sim->scheduler->enqueue(sim, core, proc);
+    ++core->nready;
+    ++sim->nready;
+    PROFILE_COUNT(&sim->profile, PHASE_READY, 1);
+    PROFILE_END(&sim->profile, PHASE_READY);
+}
+
+//  CAN THE GIVEN CORE STEAL A PROCESS FROM ANOTHER CORE'S READY QUEUE?
+bool can_steal(struct simulation *sim, int k)
+{
+    return sim->steal_policy != STEAL_NONE && sim->nready > sim->cores[k].nready;
+}
+
+int find_steal_policy_byname(const char name[], int length)
+{
+    for(int s=0 ; steal_policies[s] != NULL ; ++s) {
+        if(word_is(name, length, steal_policies[s])) {
+            return s;
+        }
+    }
+    return UNKNOWN;
+}
+
+int find_steal_victim(struct simulation *sim, int thief)
+{
+    struct core *cores  = sim->cores;
+    int victim          = UNKNOWN;
+
+    switch (sim->steal_policy) {
+        case STEAL_BUSIEST:
+            FOREACH_CORE(sim) {
+                if(k != thief && cores[k].nready > 0 &&
+                   (victim == UNKNOWN || cores[k].nready > cores[victim].nready)) {
+                    victim  = k;
+                }
+            }
+            break;
+
+        case STEAL_NEIGHBOUR:
+            for(int n=1 ; n<sim->ncores ; ++n) {
+                int k   = (thief+n) % sim->ncores;
+
+                if(cores[k].nready > 0) {
+                    victim  = k;
+                    break;
+                }
+            }
+            break;
+    }
+    return victim;
+}
+
+//  MOVE THE LEAST URGENT PROCESS IN ANOTHER CORE'S READY QUEUE TO THIS CORE'S QUEUE
+void steal_READY_process(struct simulation *sim)
+{
+    struct core *thief  = &sim->cores[sim->current_core];
+    int victim          = find_steal_victim(sim, sim->current_core);
+    int proc            = sim->scheduler->steal(sim, &sim->cores[victim], thief);
+
+    --sim->cores[victim].nready;
+    ++thief->nready;
+    ++thief->nsteals;
+
+    TRACE(sim, EVENT_STOLEN, sim->processes[proc].pid, victim, 0, 0, 0);
+    advance_time(sim, sim->time_steal);
+}
+
+int dequeue_READY_queue(struct simulation *sim)
+{
+    struct core *core   = &sim->cores[sim->current_core];
+    int proc            = UNKNOWN;
+    PROFILE_BEGIN();
+
+    if(core->nready == 0 && can_steal(sim, sim->current_core)) {
+        steal_READY_process(sim);
+    }
+    if(core->nready > 0) {
+        proc   = sim->scheduler->dequeue(sim, core);
+        --core->nready;
+        --sim->nready;
+        enter_state(sim, proc, STATE_RUNNING);
+        TRACE(sim, EVENT_RUNNING, sim->processes[proc].pid, UNKNOWN, 0, 0, 0);
+        advance_time(sim, TIME_CONTEXT_SWITCH);
+
+        ++core->ncontext_switches;
+        core->time_switching    += TIME_CONTEXT_SWITCH;
+        PROFILE_COUNT(&sim->profile, PHASE_READY, 1);
+    }
+    PROFILE_END(&sim->profile, PHASE_READY);
+    return proc;
+}
+
+//  ----------------------------------------------------------------------
+
+//  NOTHING TO UNDERSTAND IN THIS SECTION! - (see  man stdarg  if interested)
+#include <time.h>           // only used to report real-world rebooting time
+
+void fail(struct failure *f, char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(f->message, sizeof f->message, fmt, ap);
+    va_end(ap);
+    longjmp(f->on_error, 1);
+}
+
+//  THE NAME AND ITS onCPU TIME ARE RIGHT-JUSTIFIED TOGETHER, IN 24 COLUMNS
+void print_DEBUG_line(FILE *fp, usecs_t usecs, int ncores, int core,
+                      char text[], const char name[], char oncpu[])
+{
+    int width   = 24 - (int)strlen(oncpu);
+
+//  WITH MULTIPLE CORES, EACH LINE ALSO SHOWS WHICH CORE IS EXECUTING
+    if(ncores > 1) {
+        fprintf(fp, "@%08lli cpu%-3i %-80s%*s%s\n", usecs, core, text,
+                        (width > 0) ? width : 0, name, oncpu);
+    }
+    else {
+        fprintf(fp, "@%08lli   %-80s%*s%s\n", usecs, text,
+                        (width > 0) ? width : 0, name, oncpu);
+    }
+}
+
+//  ----------------------------------------------------------------------
+
+struct trace_record {
+    usecs_t     usecs;                  // when the event occurred
+    long long   pid;                    // or UNKNOWN
+    int         event;
+    int         core;
+    int         which;
+    long long   arg[3];
+};
+
+//  A BINARY TRACE FILE BEGINS WITH THIS HEADER, THEN THE NAMES OF ALL
+//  COMMANDS AND DEVICES (EACH NUL-TERMINATED), THEN THE BUS OF EACH DEVICE,
+//  THEN THE RECORDS, ALL IN THE HOST'S BYTE ORDER
+#define TRACE_MAGIC             "MYSCHED"
+#define TRACE_VERSION           3
+
+struct trace_header {
+    char        magic[8];
+    int         version;
+    int         record_size;
+    int         ncores;
+    int         ncommands;
+    int         ndevices;
+    int         nbuses;
+};
+
+//  ----------------------------------------------------------------------
+
+//  THE RENDERER TURNS RECORDS BACK INTO THE TEXT TRACE, EXACTLY AS IT WAS
+//  ONCE PRINTED WHILE EACH TICK EXECUTED, OR INTO A CHROME/PERFETTO JSON
+//  TRACE.  IT IS USED BOTH TO PRINT A LIVE TRACE, AND TO DECODE A BINARY ONE.
+
+struct renderer {
+    FILE        *out;
+    int         format;                 // MS_TRACE_TEXT or MS_TRACE_JSON
+    int         ncores;
+    const char  **commands;             // names of commands and devices
+    int         ncommands;
+    const char  **devices;
+    int         ndevices;
+    int         *device_buses;
+    int         nbuses;
+
+    char        line[1024];             // the current line of text
+    char        *lp;
+
+//  THE TICKS SKIPPED BY ALL CORES TOGETHER, NOT YET RENDERED
+    struct trace_record *spans;
+    int         nspans;
+    int         spans_capacity;
+
+//  FOR JSON, EACH CORE'S CURRENT RUN OF COMPUTING, JOINED FROM CONTIGUOUS TICKS
+    struct trace_record *running;
+    int         nevents;
+
+    bool        out_of_memory;          // so nothing more is rendered
+};
+
+char *state_names[] = {
+    "READY", "RUNNING", "SLEEPING", "WAITING", "BLOCKED", "EXIT", "NEW"
+};
+
+const char *command_name(struct renderer *r, int c)
+{
+    return (c >= 0 && c < r->ncommands) ? r->commands[c] : "?";
+}
+
+const char *device_name(struct renderer *r, int d)
+{
+    return (d >= 0 && d < r->ndevices) ? r->devices[d] : "?";
+}
+
+//  THE BUS OF A DEVICE, AND ITS NAME (JUST "DATABUS" IF IT IS THE ONLY ONE)
+int device_bus(struct renderer *r, int d)
+{
+    return (d >= 0 && d < r->ndevices) ? r->device_buses[d] : 0;
+}
+
+const char *bus_name(struct renderer *r, int b, char name[])
+{
+    if(r->nbuses > 1) {
+        sprintf(name, "DATABUS%i", b);
+    }
+    else {
+        strcpy(name, "DATABUS");
+    }
+    return name;
+}
+
+const char *syscall_name(long long s)
+{
+    return (s >= SYS_SPAWN && s <= SYS_EXIT) ? syscalls[s] : "?";
+}
+
+void add_to_line(struct renderer *r, char *fmt, ...)
+{
+    char    *end    = &r->line[sizeof r->line];
+    va_list ap;
+
+    if(r->line[0] && r->lp+2 < end) {
+        *r->lp++    = ',';
+        *r->lp++    = ' ';
+    }
+    va_start(ap, fmt);
+    vsnprintf(r->lp, end - r->lp, fmt, ap);
+    va_end(ap);
+
+    while(*r->lp) {
+        ++r->lp;
+    }
+}
+
+void end_line(struct renderer *r, usecs_t usecs, int core, int command, usecs_t oncpu)
+{
+    if(r->line[0]) {                    // anything to output?
+        const char *name    = "";
+        char oncpu_text[32];
+        oncpu_text[0]       = '\0';
+
+        if(r->line[0] == '+') {
+            name    = "OS";
+        }
+        else if(command != UNKNOWN) {
+            name    = command_name(r, command);
+            sprintf(oncpu_text, "(onCPU=%lli)", oncpu);
+        }
+        print_DEBUG_line(r->out, usecs, r->ncores, core, r->line, name, oncpu_text);
+        r->line[0]  = '\0';
+        r->lp       = r->line;
+    }
+}
+
+//  THE CORES TICK TOGETHER, EACH TICK BEING EXECUTED BY EACH CORE IN TURN,
+//  SO THE TICKS OF ALL PENDING SPANS ARE PRINTED IN ORDER OF TIME, THEN CORE
+void render_spans(struct renderer *r)
+{
+    while(r->nspans > 0) {
+        int first   = 0;
+
+        for(int s=1 ; s<r->nspans ; ++s) {
+            if(r->spans[s].usecs < r->spans[first].usecs ||
+               (r->spans[s].usecs == r->spans[first].usecs && r->spans[s].core < r->spans[first].core)) {
+                first   = s;
+            }
+        }
+        struct trace_record *span   = &r->spans[first];
+
+        if(span->event == EVENT_COMPUTE_SPAN) {
+            add_to_line(r, "c");
+            end_line(r, span->usecs, span->core, span->which, span->arg[1]++);
+        }
+        else {
+            add_to_line(r, "idle");
+            end_line(r, span->usecs, span->core, UNKNOWN, 0);
+        }
+        if(++span->usecs == span->arg[0]) {
+            r->spans[first] = r->spans[--r->nspans];
+        }
+    }
+}
+
+void render_text(struct renderer *r, struct trace_record *rec)
+{
+    char    bus[32];
+
+    if(rec->event == EVENT_COMPUTE_SPAN || rec->event == EVENT_IDLE_SPAN) {
+        if(rec->usecs < rec->arg[0]) {
+            if(r->nspans == r->spans_capacity) {
+                int     capacity    = (r->spans_capacity == 0) ? 16 : 2*r->spans_capacity;
+                struct trace_record *spans  = realloc(r->spans, capacity * sizeof r->spans[0]);
+
+                if(spans == NULL) {
+                    r->out_of_memory    = true;
+                    return;
+                }
+                r->spans            = spans;
+                r->spans_capacity   = capacity;
+            }
+            r->spans[r->nspans++]   = *rec;
+        }
+        return;
+    }
+    render_spans(r);
+
+    switch (rec->event) {
+    case EVENT_FLUSH:
+        end_line(r, rec->usecs, rec->core, rec->which, rec->arg[0]);
+        break;
+
+    case EVENT_REBOOT: {
+        time_t  when    = rec->arg[0];
+        char    t[32];
+
+        ctime_r(&when, t);
+        t[19]   = '\0';
+        add_to_line(r, "REBOOTING at %s, with timequantum=%lli", t, rec->arg[1]);
+        break;
+    }
+    case EVENT_SPAWN:
+        add_to_line(r, "spawn '%s'", command_name(r, rec->which));
+        break;
+    case EVENT_READY:
+        add_to_line(r, "pid%lli.%s->READY", rec->pid, state_names[rec->which]);
+        break;
+    case EVENT_NO_TRANSITION:
+        add_to_line(r, "transition takes 0usecs");
+        break;
+    case EVENT_TRANSITION:
+        add_to_line(r, "transition takes %lliusecs (%lli..%lli)", rec->arg[0],
+                        rec->usecs+1, rec->usecs+rec->arg[0]);
+        end_line(r, rec->usecs, rec->core, UNKNOWN, 0);
+
+        for(usecs_t t=1 ; t <= rec->arg[0] ; ++t) {
+            add_to_line(r, "+");
+            end_line(r, rec->usecs+t, rec->core, UNKNOWN, 0);
+        }
+        break;
+    case EVENT_EXIT:
+        add_to_line(r, "exit, pid%lli.RUNNING->EXIT", rec->pid);
+        break;
+    case EVENT_BLOCKED:
+        add_to_line(r, "%s %llibytes, pid%lli.RUNNING->BLOCKED", syscall_name(rec->which),
+                        rec->arg[0], rec->pid);
+        break;
+    case EVENT_IO_COMPLETE:
+        add_to_line(r, "device.%s completes %s", device_name(r, rec->which), syscall_name(rec->arg[0]));
+        break;
+    case EVENT_DATABUS_IDLE:
+        add_to_line(r, "%s is now idle", bus_name(r, rec->which, bus));
+        break;
+    case EVENT_ACQUIRE_BUS:
+        add_to_line(r, "device.%s acquiring %s, %s %lli bytes, will take %lliusecs (%i+%lli)",
+                        device_name(r, rec->which), bus_name(r, device_bus(r, rec->which), bus), (rec->arg[0] == SYS_READ) ? "reading" : "writing",
+                        rec->arg[1], TIME_ACQUIRE_BUS+rec->arg[2], TIME_ACQUIRE_BUS, rec->arg[2]);
+        break;
+    case EVENT_COALESCED:
+        add_to_line(r, "device.%s continues on %s, %s %lli bytes, will take %lliusecs (coalesced)",
+                        device_name(r, rec->which), bus_name(r, device_bus(r, rec->which), bus), (rec->arg[0] == SYS_READ) ? "reading" : "writing",
+                        rec->arg[1], rec->arg[2]);
+        break;
+    case EVENT_STOLEN:
+        add_to_line(r, "pid%lli stolen from cpu%i", rec->pid, rec->which);
+        break;
+    case EVENT_RUNNING:
+        add_to_line(r, "pid%lli.READY->RUNNING", rec->pid);
+        break;
+    case EVENT_ON_CPU:
+        add_to_line(r, "pid%lli now on CPU, gets new timequantum", rec->pid);
+        break;
+    case EVENT_WAITING:
+        add_to_line(r, "wait, pid%lli.RUNNING->WAITING", rec->pid);
+        break;
+    case EVENT_WAIT_NO_CHILDREN:
+        add_to_line(r, "wait (but no child processes)");
+        break;
+    case EVENT_SLEEPING:
+        add_to_line(r, "sleep %lli, pid%lli.RUNNING->SLEEPING", rec->arg[0], rec->pid);
+        break;
+    case EVENT_TQ_EXPIRED:
+        add_to_line(r, "timequantum expired");
+        break;
+    case EVENT_COMPUTE:
+        add_to_line(r, "c");
+        break;
+    case EVENT_IDLE:
+        add_to_line(r, "idle");
+        break;
+    case EVENT_SHUTDOWN:
+        add_to_line(r, "nprocesses=0, SHUTDOWN");
+        break;
+    case EVENT_SUMMARY:
+        add_to_line(r, "%lliusecs total system time, %lliusecs onCPU by all processes, %lli/%lli -> %lli%%",
+                        rec->usecs, rec->arg[0], rec->arg[0], rec->usecs, rec->arg[1]);
+        break;
+    }
+}
+
+//  ----------------------------------------------------------------------
+
+//  IN A CHROME/PERFETTO JSON TRACE, EACH CORE IS A THREAD SHOWING THE
+//  PROCESSES IT RUNS AND ITS TRANSITIONS, ANOTHER THREAD SHOWS THE DATABUS,
+//  AND ALL OTHER EVENTS ARE INSTANTS (WITH THE pid IN THEIR args).
+
+void json_string(FILE *fp, const char str[])
+{
+    fputc('"', fp);
+    for(const char *s=str ; *s ; ++s) {
+        if(*s == '"' || *s == '\\') {
+            fprintf(fp, "\\%c", *s);
+        }
+        else if((unsigned char)*s < ' ') {
+            fprintf(fp, "\\u%04x", *s);
+        }
+        else {
+            fputc(*s, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+void json_event(struct renderer *r, const char name[], char ph, usecs_t ts, int tid, char *fmt, ...)
+{
+    fprintf(r->out, "%s\n{\"name\":", (r->nevents++ == 0) ? "" : ",");
+    json_string(r->out, name);
+    fprintf(r->out, ",\"ph\":\"%c\",\"ts\":%lli,\"pid\":1,\"tid\":%i", ph, ts, tid);
+    if(ph == 'i') {
+        fprintf(r->out, ",\"s\":\"t\"");
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(r->out, fmt, ap);
+    va_end(ap);
+    fprintf(r->out, "}");
+}
+
+//  END A CORE'S CURRENT RUN OF COMPUTING
+void json_end_running(struct renderer *r, int core)
+{
+    struct trace_record *run    = &r->running[core];
+
+    if(run->pid != UNKNOWN) {
+        json_event(r, command_name(r, run->which), 'X', run->usecs, core,
+                    ",\"dur\":%lli,\"args\":{\"pid\":%lli}", run->arg[0] - run->usecs, run->pid);
+        run->pid    = UNKNOWN;
+    }
+}
+
+void json_computing(struct renderer *r, int core, long long pid, int command, usecs_t from, usecs_t until)
+{
+    struct trace_record *run    = &r->running[core];
+
+    if(run->pid != pid || run->arg[0] != from) {
+        json_end_running(r, core);
+        run->pid    = pid;
+        run->which  = command;
+        run->usecs  = from;
+    }
+    run->arg[0] = until;
+}
+
+void render_json(struct renderer *r, struct trace_record *rec)
+{
+    int core    = (rec->core >= 0 && rec->core < r->ncores) ? rec->core : 0;
+    int bus     = r->ncores + device_bus(r, rec->which);     // each databus's thread
+
+    switch (rec->event) {
+    case EVENT_COMPUTE_SPAN:
+        json_computing(r, core, rec->pid, rec->which, rec->usecs, rec->arg[0]);
+        break;
+    case EVENT_COMPUTE:
+        json_computing(r, core, rec->pid, rec->which, rec->usecs, rec->usecs+1);
+        break;
+    case EVENT_TRANSITION:
+        json_end_running(r, core);
+        json_event(r, "transition", 'X', rec->usecs, core, ",\"dur\":%lli", rec->arg[0]);
+        break;
+    case EVENT_ACQUIRE_BUS:
+        json_event(r, device_name(r, rec->which), 'X', rec->usecs, bus,
+                    ",\"dur\":%lli,\"args\":{\"pid\":%lli,\"syscall\":\"%s\",\"bytes\":%lli}",
+                    TIME_ACQUIRE_BUS+rec->arg[2], rec->pid, syscall_name(rec->arg[0]), rec->arg[1]);
+        break;
+    case EVENT_COALESCED:
+        json_event(r, device_name(r, rec->which), 'X', rec->usecs, bus,
+                    ",\"dur\":%lli,\"args\":{\"pid\":%lli,\"syscall\":\"%s\",\"bytes\":%lli,\"coalesced\":true}",
+                    rec->arg[2], rec->pid, syscall_name(rec->arg[0]), rec->arg[1]);
+        break;
+    case EVENT_REBOOT:
+        json_event(r, "reboot", 'i', rec->usecs, core, ",\"args\":{\"timequantum\":%lli}", rec->arg[1]);
+        break;
+    case EVENT_SPAWN:
+        json_event(r, "spawn", 'i', rec->usecs, core, ",\"args\":{\"pid\":%lli,\"command\":%i}",
+                    rec->pid, rec->which);
+        break;
+    case EVENT_READY:
+        json_event(r, "ready", 'i', rec->usecs, core, ",\"args\":{\"pid\":%lli,\"from\":\"%s\"}",
+                    rec->pid, state_names[rec->which]);
+        break;
+    case EVENT_EXIT:
+    case EVENT_RUNNING:
+    case EVENT_WAITING:
+    case EVENT_TQ_EXPIRED:
+        json_event(r, (rec->event == EVENT_EXIT) ? "exit" : (rec->event == EVENT_RUNNING) ? "running" :
+                      (rec->event == EVENT_WAITING) ? "wait" : "timequantum expired",
+                    'i', rec->usecs, core, ",\"args\":{\"pid\":%lli}", rec->pid);
+        break;
+    case EVENT_BLOCKED:
+        json_event(r, syscall_name(rec->which), 'i', rec->usecs, core,
+                    ",\"args\":{\"pid\":%lli,\"bytes\":%lli}", rec->pid, rec->arg[0]);
+        break;
+    case EVENT_STOLEN:
+        json_event(r, "stolen", 'i', rec->usecs, core, ",\"args\":{\"pid\":%lli,\"from\":%i}",
+                    rec->pid, rec->which);
+        break;
+    case EVENT_SLEEPING:
+        json_event(r, "sleep", 'i', rec->usecs, core, ",\"args\":{\"pid\":%lli,\"usecs\":%lli}",
+                    rec->pid, rec->arg[0]);
+        break;
+    case EVENT_SHUTDOWN:
+        json_event(r, "shutdown", 'i', rec->usecs, core, "");
+        break;
+    }
+}
+
+//  ----------------------------------------------------------------------
+
+void init_renderer(struct renderer *r, FILE *out, int format, int ncores, int nbuses)
+{
+    memset(r, 0, sizeof *r);
+    r->out      = out;
+    r->format   = format;
+    r->ncores   = ncores;
+    r->nbuses   = nbuses;
+    r->lp       = r->line;
+
+    if(format == MS_TRACE_JSON) {
+        r->running  = malloc((ncores+1) * sizeof r->running[0]);
+        if(r->running == NULL) {
+            r->out_of_memory    = true;
+            return;
+        }
+        for(int k=0 ; k<ncores ; ++k) {
+            r->running[k].pid   = UNKNOWN;
+        }
+        fprintf(out, "{\"traceEvents\":[");
+        for(int k=0 ; k<ncores+nbuses ; ++k) {
+            char    name[32];
+
+            if(k < ncores) {
+                sprintf(name, "cpu%i", k);
+            }
+            else {
+                bus_name(r, k-ncores, name);
+            }
+            json_event(r, "thread_name", 'M', 0, k, ",\"args\":{\"name\":\"%s\"}", name);
+        }
+    }
+}
+
+void render(struct renderer *r, struct trace_record *rec)
+{
+    if(r->out_of_memory) {
+        return;
+    }
+    if(r->format == MS_TRACE_JSON) {
+        render_json(r, rec);
+    }
+    else {
+        render_text(r, rec);
+    }
+}
+
+void finish_renderer(struct renderer *r)
+{
+    if(r->format == MS_TRACE_JSON) {
+        for(int k=0 ; r->running != NULL && k<r->ncores ; ++k) {
+            json_end_running(r, k);
+        }
+        fprintf(r->out, "\n]}\n");
+    }
+    else {
+        render_spans(r);
+    }
+    fflush(r->out);
+    free(r->spans);
+    free(r->running);
+}
+
+//  ----------------------------------------------------------------------
+
+//  RECORDS ARE COLLECTED INTO CHUNKS OF A RING BUFFER, AND EACH FULL CHUNK IS
+//  HANDED TO A BACKGROUND THREAD THAT WRITES OR RENDERS IT, SO THAT THE
+//  SIMULATION ONLY WAITS FOR THE WRITER WHEN ALL CHUNKS ARE FULL.
+
+#include <pthread.h>
+
+#define TRACE_CHUNK             4096    // records per chunk
+#define TRACE_NCHUNKS           16
+
+struct tracer {
+    struct trace_record (*chunks)[TRACE_CHUNK];
+    int             nrecords[TRACE_NCHUNKS];
+    int             fill;               // #records in the chunk being filled
+    long long       filled, drained;    // #chunks handed over, #written
+
+    bool            closing;
+    pthread_mutex_t lock;
+    pthread_cond_t  changed;
+    pthread_t       writer;
+
+    FILE            *out;
+    int             format;
+    struct renderer renderer;
+};
+
+void *trace_writer(void *arg)
+{
+    struct tracer *t    = arg;
+
+    for(;;) {
+        pthread_mutex_lock(&t->lock);
+        while(t->drained == t->filled && !t->closing) {
+            pthread_cond_wait(&t->changed, &t->lock);
+        }
+        if(t->drained == t->filled) {   // closing, and all written
+            pthread_mutex_unlock(&t->lock);
+            break;
+        }
+        int chunk   = t->drained % TRACE_NCHUNKS;
+        pthread_mutex_unlock(&t->lock);
+
+        if(t->format == MS_TRACE_BINARY) {
+            fwrite(t->chunks[chunk], sizeof t->chunks[chunk][0], t->nrecords[chunk], t->out);
+        }
+        else {
+            for(int n=0 ; n<t->nrecords[chunk] ; ++n) {
+                render(&t->renderer, &t->chunks[chunk][n]);
+            }
+        }
+
+        pthread_mutex_lock(&t->lock);
+        ++t->drained;
+        pthread_cond_signal(&t->changed);
+        pthread_mutex_unlock(&t->lock);
+    }
+    if(t->format == MS_TRACE_BINARY) {
+        fflush(t->out);
+    }
+    else {
+        finish_renderer(&t->renderer);
+    }
+    return NULL;
+}
+
+//  HAND THE CHUNK BEING FILLED TO THE WRITER, WAITING IF NO CHUNK IS FREE
+void hand_over_chunk(struct tracer *t)
+{
+    pthread_mutex_lock(&t->lock);
+    t->nrecords[t->filled % TRACE_NCHUNKS] = t->fill;
+    ++t->filled;
+    pthread_cond_signal(&t->changed);
+    while(t->filled - t->drained == TRACE_NCHUNKS) {
+        pthread_cond_wait(&t->changed, &t->lock);
+    }
+    pthread_mutex_unlock(&t->lock);
+    t->fill = 0;
+}
+
+void open_tracer(struct simulation *sim, FILE *out, int format)
+{
+    const struct workload *w    = sim->w;
+    struct tracer *t            = calloc(1, sizeof *t);
+
+    if(t == NULL || (t->chunks = malloc(TRACE_NCHUNKS * sizeof t->chunks[0])) == NULL) {
+        free(t);
+        fail(&sim->failure, "ERROR - out of memory for trace");
+    }
+    t->out      = out;
+    t->format   = format;
+
+    if(format == MS_TRACE_BINARY) {
+        struct trace_header header  = { TRACE_MAGIC, TRACE_VERSION, sizeof(struct trace_record),
+                                        sim->ncores, w->ncommands, w->ndevices, sim->nbuses };
+
+        fwrite(&header, sizeof header, 1, out);
+        FOREACH_COMMAND(w) {
+            fwrite(COMMAND_NAME(w, c), 1, strlen(COMMAND_NAME(w, c))+1, out);
+        }
+        FOREACH_DEVICE(w) {
+            fwrite(DEVICE_NAME(w, d), 1, strlen(DEVICE_NAME(w, d))+1, out);
+        }
+        FOREACH_DEVICE(w) {
+            fwrite(&w->devices[d].bus, sizeof w->devices[d].bus, 1, out);
+        }
+    }
+    else {
+        struct renderer *r  = &t->renderer;
+
+        init_renderer(r, out, format, sim->ncores, sim->nbuses);
+        r->commands     = malloc((w->ncommands+1) * sizeof r->commands[0]);
+        r->devices      = malloc((w->ndevices+1) * sizeof r->devices[0]);
+        r->device_buses = malloc((w->ndevices+1) * sizeof r->device_buses[0]);
+        if(r->out_of_memory || r->commands == NULL || r->devices == NULL || r->device_buses == NULL) {
+            free(r->commands); free(r->devices); free(r->device_buses);
+            free(r->running);
+            free(t->chunks);
+            free(t);
+            fail(&sim->failure, "ERROR - out of memory for trace");
+        }
+        r->ncommands    = w->ncommands;
+        r->ndevices     = w->ndevices;
+        FOREACH_COMMAND(w) {
+            r->commands[c]  = COMMAND_NAME(w, c);
+        }
+        FOREACH_DEVICE(w) {
+            r->devices[d]       = DEVICE_NAME(w, d);
+            r->device_buses[d]  = w->devices[d].bus;
+        }
+    }
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->changed, NULL);
+    pthread_create(&t->writer, NULL, trace_writer, t);
+    sim->tracer = t;
+}
+
+//  WRITE ALL REMAINING RECORDS, AND WAIT FOR THE WRITER TO FINISH,
+//  RETURNING WHY THE TRACE IS INCOMPLETE, OR NULL IF IT IS NOT
+const char *close_tracer(struct simulation *sim)
+{
+    struct tracer *t    = sim->tracer;
+    const char  *error  = NULL;
+
+    if(t != NULL) {
+        pthread_mutex_lock(&t->lock);
+        t->nrecords[t->filled % TRACE_NCHUNKS] = t->fill;
+        if(t->fill > 0) {
+            ++t->filled;
+        }
+        t->closing  = true;
+        pthread_cond_signal(&t->changed);
+        pthread_mutex_unlock(&t->lock);
+        pthread_join(t->writer, NULL);
+
+        pthread_mutex_destroy(&t->lock);
+        pthread_cond_destroy(&t->changed);
+        if(t->renderer.out_of_memory) {
+            error   = "ERROR - out of memory for trace";
+        }
+        else if(ferror(t->out)) {       // after any failed write by the writer thread
+            error   = "ERROR - cannot write trace";
+        }
+        free(t->renderer.commands);
+        free(t->renderer.devices);
+        free(t->renderer.device_buses);
+        free(t->chunks);
+        free(t);
+        sim->tracer = NULL;
+    }
+    return error;
+}
+
+void add_record(struct tracer *t, usecs_t usecs, int event, int core, long long pid, int which,
+                long long arg0, long long arg1, long long arg2)
+{
+    struct trace_record *rec    = &t->chunks[t->filled % TRACE_NCHUNKS][t->fill];
+
+    rec->usecs  = usecs;
+    rec->event  = event;
+    rec->core   = core;
+    rec->pid    = pid;
+    rec->which  = which;
+    rec->arg[0] = arg0;
+    rec->arg[1] = arg1;
+    rec->arg[2] = arg2;
+
+    if(++t->fill == TRACE_CHUNK) {
+        hand_over_chunk(t);
+    }
+}
+
+void trace_event(struct simulation *sim, int event, long long pid, int which,
+                 long long arg0, long long arg1, long long arg2)
+{
+    PROFILE_BEGIN();
+    add_record(sim->tracer, sim->USECS_SINCE_REBOOT, event, sim->current_core,
+                pid, which, arg0, arg1, arg2);
+    PROFILE_COUNT(&sim->profile, PHASE_TRACE, 1);
+    PROFILE_END(&sim->profile, PHASE_TRACE);
+}
+
+//  RECORD THE TICKS THAT A CORE SKIPS, COMPUTING OR IDLE
+void trace_span(struct simulation *sim, int core, usecs_t from, usecs_t until)
+{
+    int proc    = sim->cores[core].proc_on_CPU;
+    PROFILE_BEGIN();
+
+    if(proc == UNKNOWN) {
+        add_record(sim->tracer, from, EVENT_IDLE_SPAN, core, UNKNOWN, UNKNOWN, until, 0, 0);
+    }
+    else {
+        struct process *p   = &sim->processes[proc];
+
+        add_record(sim->tracer, from, EVENT_COMPUTE_SPAN, core, p->pid, p->command,
+                    until, p->time_on_CPU+1, 0);
+    }
+    PROFILE_COUNT(&sim->profile, PHASE_TRACE, 1);
+    PROFILE_END(&sim->profile, PHASE_TRACE);
+}
+
+//  END THE CURRENT LINE, NAMING THE PROCESS ON THE CPU (IF ANY)
+void trace_flush(struct simulation *sim, int proc_on_CPU)
+{
+    if(proc_on_CPU == UNKNOWN) {
+        TRACE(sim, EVENT_FLUSH, UNKNOWN, UNKNOWN, 0, 0, 0);
+    }
+    else {
+        struct process *p   = &sim->processes[proc_on_CPU];
+
+        TRACE(sim, EVENT_FLUSH, p->pid, p->command, p->time_on_CPU, 0, 0);
+    }
+}
+
+//  RENDER A BINARY TRACE, AS TEXT OR JSON
+int ms_decode_trace(FILE *in, FILE *out, int format)
+{
+    struct trace_header header;
+
+    if(fread(&header, sizeof header, 1, in) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof header.magic) != 0 ||
+       header.version != TRACE_VERSION || header.record_size != sizeof(struct trace_record) ||
+       header.ncores < 1 || header.ncommands < 0 || header.ndevices < 0 || header.nbuses < 1) {
+        return -1;
+    }
+
+//  READ THE NAMES OF ALL COMMANDS AND DEVICES
+    int         nnames  = header.ncommands + header.ndevices;
+    const char  **names = malloc((nnames+1) * sizeof names[0]);
+    char        *pool   = NULL;
+    int         size    = 0, capacity = 0;
+    int         *start  = malloc((nnames+1) * sizeof start[0]);
+    int         ch;
+
+    if(names == NULL || start == NULL) {
+        free(names); free(start);
+        return -1;
+    }
+    for(int n=0 ; n<nnames ; ++n) {
+        start[n]    = size;
+        do {
+            if((ch = getc(in)) == EOF) {
+                free(names); free(start); free(pool);
+                return -1;
+            }
+            if(size == capacity) {
+                char    *newpool    = realloc(pool, (capacity == 0) ? 1024 : 2*capacity);
+
+                if(newpool == NULL) {
+                    free(names); free(start); free(pool);
+                    return -1;
+                }
+                pool        = newpool;
+                capacity    = (capacity == 0) ? 1024 : 2*capacity;
+            }
+            pool[size++]    = ch;
+        } while(ch != '\0');
+    }
+    for(int n=0 ; n<nnames ; ++n) {
+        names[n]    = &pool[start[n]];
+    }
+
+//  AND THE BUS OF EACH DEVICE
+    int *buses  = malloc((header.ndevices+1) * sizeof buses[0]);
+
+    if(buses == NULL || (int)fread(buses, sizeof buses[0], header.ndevices, in) != header.ndevices) {
+        free(names); free(start); free(pool); free(buses);
+        return -1;
+    }
+    for(int d=0 ; d<header.ndevices ; ++d) {
+        if(buses[d] < 0 || buses[d] >= header.nbuses) {
+            buses[d]    = 0;
+        }
+    }
+
+    struct renderer r;
+    init_renderer(&r, out, format, header.ncores, header.nbuses);
+    r.commands      = names;
+    r.ncommands     = header.ncommands;
+    r.devices       = names + header.ncommands;
+    r.ndevices      = header.ndevices;
+    r.device_buses  = buses;
+
+    struct trace_record *records    = malloc(TRACE_CHUNK * sizeof records[0]);
+    size_t              nrecords;
+
+    if(records == NULL) {
+        r.out_of_memory = true;
+    }
+    while(!r.out_of_memory && !ferror(out) &&
+          (nrecords = fread(records, sizeof records[0], TRACE_CHUNK, in)) > 0) {
+        for(size_t n=0 ; n<nrecords ; ++n) {
+            if(records[n].event == EVENT_READY &&
+               (records[n].which < 0 || records[n].which > STATE_NEW)) {
+                records[n].which    = STATE_NEW;
+            }
+            render(&r, &records[n]);
+        }
+    }
+    finish_renderer(&r);
+    free(records);
+    free(buses);
+    free(names);
+    free(start);
+    free(pool);
+    return (r.out_of_memory || ferror(out)) ? -1 : 0;
+}
+
+//  ----------------------------------------------------------------------
+
+//  SCAN THE NAME OF ONE OF A LIST OF CHOICES, SUCH AS THE steal POLICY
+int scan_choice(struct workload *w, int (*find_byname)(const char name[], int length), const char what[])
+{
+    const char  *word;
+    int         length  = scan_word(&w->failure, &w->in, &word, what);
+    int         choice  = find_byname(word, length);
+
+    if(choice == UNKNOWN) {
+        scan_error(&w->failure, &w->in, word, "unknown %s '%.*s'", what, length, word);
+    }
+    return choice;
+}
+
+//  SCAN A NUMBER THAT MUST BE POSITIVE, SUCH AS THE NUMBER OF cores
+int scan_positive(struct workload *w, const char what[])
+{
+    skip_blanks(&w->in);
+
+    const char  *start  = w->in.p;
+    long long   n       = scan_number(&w->failure, &w->in, what);
+
+    if(n <= 0 || n > INT_MAX) {
+        scan_error(&w->failure, &w->in, start, "%s must be positive", what);
+    }
+    return n;
+}
+
+void read_sysconfig(struct workload *w, const char filename[])
+{
+    struct scanner  *in = &w->in;
+
+    if(w->image.map != NULL) {
+        fail(&w->failure, "ERROR - cannot read '%s' after a workload image", filename);
+    }
+    open_scanner(&w->failure, in, filename);
+    PROFILE_COUNT(&w->profile, PHASE_PARSE, in->size);
+
+//  READ EACH LINE OF THE sysconfig FILE
+    while(next_line(in)) {
+        if(*in->p == CHAR_COMMENT) {        // ignore this line
+            continue;
+        }
+
+        const char  *keyword, *name;
+        int         length  = scan_word(&w->failure, in, &keyword, "a keyword");
+
+//  FOUND A DEVICE DEFINITION, OPTIONALLY NAMING ITS DATABUS
+        if(word_is(keyword, length, "device")) {
+            int         namelength  = scan_word(&w->failure, in, &name, "a device name");
+            long long   read_speed  = scan_number(&w->failure, in, "a read speed");
+            long long   write_speed = scan_number(&w->failure, in, "a write speed");
+            int         bus         = at_end_of_line(in) ? 0 : scan_number(&w->failure, in, "a bus");
+
+            add_device(w, name, namelength, read_speed, write_speed, bus);
+        }
+
+//  FOUND THE timequantum
+        else if(word_is(keyword, length, "timequantum")) {
+            w->config.timequantum   = scan_number(&w->failure, in, "a timequantum");
+        }
+
+//  FOUND THE NUMBER OF CPU CORES, AND HOW (AND AT WHAT COST) THEY STEAL WORK
+        else if(word_is(keyword, length, "cores")) {
+            w->config.ncores        = scan_positive(w, "the number of cores");
+        }
+        else if(word_is(keyword, length, "steal")) {
+            w->config.steal_policy  = scan_choice(w, find_steal_policy_byname, "steal policy");
+        }
+        else if(word_is(keyword, length, "stealcost")) {
+            w->config.time_steal    = scan_number(&w->failure, in, "a stealcost");
+        }
+
+//  FOUND THE NUMBER OF DATABUSES, AND HOW DEVICES ARBITRATE FOR THEM
+        else if(word_is(keyword, length, "buses")) {
+            w->config.nbuses        = scan_positive(w, "the number of buses");
+        }
+        else if(word_is(keyword, length, "arbitration")) {
+            w->config.arbitration   = scan_choice(w, find_arbitration_byname, "arbitration policy");
+        }
+        else if(word_is(keyword, length, "coalesce")) {
+            w->config.coalesce_count    = scan_positive(w, "the number of requests to coalesce");
+        }
+        else if(word_is(keyword, length, "coalescebytes")) {
+            w->config.coalesce_bytes    = scan_positive(w, "the number of bytes to coalesce");
+        }
+
+//  FOUND THE SCHEDULER ORDERING EACH READY QUEUE
+        else if(word_is(keyword, length, "scheduler")) {
+            w->config.scheduler     = scan_choice(w, find_scheduler_byname, "scheduler");
+        }
+
+//  FOUND THE seed OF THE RANDOM VALUES OF STOCHASTIC COMMANDS
+        else if(word_is(keyword, length, "seed")) {
+            w->config.seed          = scan_number(&w->failure, in, "a seed");
+        }
+        else {
+            scan_error(&w->failure, in, keyword, "'%.*s' is not recognized", length, keyword);
+        }
+        expect_end_of_line(&w->failure, in);
+    }
+    close_scanner(in);
+}
+
+//  NOT REQUIRED, BUT PROVIDES A CHECK THAT THINGS HAVE BEEN STORED CORRECTLY
+void dump_sysconfig(struct workload *w)
+{
+    FOREACH_DEVICE(w) {
+        printf("%s\t%lli\t%lli\t%i\n", DEVICE_NAME(w, d), w->devices[d].read_speed, w->devices[d].write_speed,
+                    w->devices[d].bus);
+    }
+    printf("#\ntimequantum\t%lli\n#\n", w->config.timequantum);
+    printf("cores\t%i\nsteal\t%s\nstealcost\t%lli\n#\n",
+                w->config.ncores, steal_policies[w->config.steal_policy], w->config.time_steal);
+    printf("scheduler\t%s\n#\n", schedulers[w->config.scheduler].name);
+    printf("buses\t%i\narbitration\t%s\n#\n", w->config.nbuses, arbitration_policies[w->config.arbitration]);
+    printf("seed\t%llu\n#\n", w->config.seed);
+}
+
+//  ----------------------------------------------------------------------
+
+//  A WORKLOAD'S SYMBOLS AND COMMANDS, ONCE READ AND PATCHED, MAY BE WRITTEN
+//  TO A BINARY IMAGE.  TABLES REFER TO EACH OTHER ONLY BY INDEX, SO AN IMAGE
+//  CAN BE MAPPED ANYWHERE, AND ITS TABLES USED WITHOUT PARSING OR COPYING.
+//  A command FILE THAT IS AN IMAGE IS LOADED THIS WAY, AFTER A sysconfig
+//  FILE DEFINING THE SAME DEVICES (BUT POSSIBLY DIFFERENT SPEEDS AND BUSES).
+//  AN IMAGE RECORDS ITS SOURCE'S HASH, AND IS STALE IF ITS SOURCE CHANGES.
+
+#define IMAGE_MAGIC             "MYSCHEDW"
+#define IMAGE_VERSION           3
+#define IMAGE_LAYOUT            (sizeof(struct symbol) | sizeof(struct device) << 8 | \
+                                 sizeof(struct command) << 16 | sizeof(struct syscall) << 24)
+
+struct image_header {
+    char                magic[8];
+    int                 version;
+    int                 layout;             // the sizes of its tables' entries
+    unsigned long long  checksum;           // of everything after the header
+    unsigned long long  source_hash;        // of the command file
+    long long           source_size;
+    long long           source_mtime;
+    long long           source_name;        // offset of its NUL-terminated name
+
+    int                 nsymbols, symbol_names_size, symbol_hash_size;
+    int                 ndevices, ncommands, nall_syscalls;
+    int                 ndistributions, ndistribution_params;
+    long long           symbols, symbol_names, symbol_hash;   // offsets of tables
+    long long           devices, commands, all_syscalls;
+    long long           distributions, distribution_params;
+};
+
+//  A 64-BIT HASH, CONSUMING 8 BYTES AT A TIME
+unsigned long long hash_bytes(unsigned long long hash, const void *data, size_t size)
+{
+    const unsigned char *p  = data;
+
+    for( ; size >= 8 ; p += 8, size -= 8) {
+        unsigned long long  word;
+
+        memcpy(&word, p, 8);
+        hash    = (hash ^ word) * 0x100000001b3ULL;
+        hash   ^= hash >> 29;
+    }
+    for( ; size > 0 ; ++p, --size) {
+        hash    = (hash ^ *p) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#define HASH_SEED               14695981039346656037ULL
+
+//  THE TABLES IN AN IMAGE ARE 8-BYTE ALIGNED
+static long long image_table(long long *offset, long long size)
+{
+    long long   at  = *offset;
+
+    *offset = (at + size + 7) & ~7LL;
+    return at;
+}
+
+void write_image(struct workload *w, const char filename[])
+{
+    if(w->source_name == NULL || w->ncommands == 0) {
+        fail(&w->failure, "ERROR - no commands to write to '%s'", filename);
+    }
+
+//  LAY OUT THE TABLES AFTER THE HEADER
+    struct image_header h;
+    long long   size    = sizeof h;
+
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, IMAGE_MAGIC, sizeof h.magic);
+    h.version           = IMAGE_VERSION;
+    h.layout            = IMAGE_LAYOUT;
+    h.source_hash       = w->source_hash;
+    h.source_size       = w->source_size;
+    h.source_mtime      = w->source_mtime;
+    h.nsymbols          = w->nsymbols;
+    h.symbol_names_size = w->symbol_names_size;
+    h.symbol_hash_size  = w->symbol_hash_size;
+    h.ndevices          = w->ndevices;
+    h.ncommands         = w->ncommands;
+    h.nall_syscalls     = w->nall_syscalls;
+    h.ndistributions    = w->ndistributions;
+    h.ndistribution_params  = w->ndistribution_params;
+
+    h.source_name       = image_table(&size, strlen(w->source_name)+1);
+    h.symbols           = image_table(&size, w->nsymbols * sizeof w->symbols[0]);
+    h.symbol_names      = image_table(&size, w->symbol_names_size);
+    h.symbol_hash       = image_table(&size, w->symbol_hash_size * sizeof w->symbol_hash[0]);
+    h.devices           = image_table(&size, w->ndevices * sizeof w->devices[0]);
+    h.commands          = image_table(&size, w->ncommands * sizeof w->commands[0]);
+    h.all_syscalls      = image_table(&size, w->nall_syscalls * sizeof w->all_syscalls[0]);
+    h.distributions     = image_table(&size, w->ndistributions * sizeof w->distributions[0]);
+    h.distribution_params   = image_table(&size, w->ndistribution_params * sizeof w->distribution_params[0]);
+
+//  COPY THE TABLES, THEN CHECKSUM THEM
+    char    *image  = calloc(1, size);
+
+    if(image == NULL) {
+        fail(&w->failure, "ERROR - out of memory writing '%s'", filename);
+    }
+    strcpy(&image[h.source_name], w->source_name);
+    memcpy(&image[h.symbols],       w->symbols,         w->nsymbols * sizeof w->symbols[0]);
+    memcpy(&image[h.symbol_names],  w->symbol_names,    w->symbol_names_size);
+    memcpy(&image[h.symbol_hash],   w->symbol_hash,     w->symbol_hash_size * sizeof w->symbol_hash[0]);
+    memcpy(&image[h.devices],       w->devices,         w->ndevices * sizeof w->devices[0]);
+    memcpy(&image[h.commands],      w->commands,        w->ncommands * sizeof w->commands[0]);
+    memcpy(&image[h.all_syscalls],  w->all_syscalls,    w->nall_syscalls * sizeof w->all_syscalls[0]);
+    if(w->ndistributions > 0) {
+        memcpy(&image[h.distributions], w->distributions,
+                    w->ndistributions * sizeof w->distributions[0]);
+        memcpy(&image[h.distribution_params], w->distribution_params,
+                    w->ndistribution_params * sizeof w->distribution_params[0]);
+    }
+
+    h.checksum  = hash_bytes(HASH_SEED, image + sizeof h, size - sizeof h);
+    memcpy(image, &h, sizeof h);
+
+    FILE    *fp = fopen(filename, "wb");
+    bool    ok  = (fp != NULL && fwrite(image, 1, size, fp) == (size_t)size);
+
+    if(fp != NULL && fclose(fp) != 0) {
+        ok  = false;
+    }
+    free(image);
+    if(!ok) {
+        fail(&w->failure, "ERROR - cannot write '%s'", filename);
+    }
+}
+
+//  AN IMAGE IS STALE IF ITS SOURCE STILL EXISTS, BUT HAS CHANGED
+bool image_is_stale(struct workload *w, const struct image_header *h, const char source[])
+{
+    struct stat st;
+
+    if(stat(source, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    if(st.st_size == h->source_size && st.st_mtime == h->source_mtime) {
+        return false;
+    }
+
+    struct scanner  in;
+    open_scanner(&w->failure, &in, source);
+    bool            stale   = hash_bytes(HASH_SEED, in.map, in.size) != h->source_hash;
+    close_scanner(&in);
+
+    return stale;
+}
+
+//  ADOPT THE TABLES OF AN IMAGE, ALREADY MAPPED BY THE SCANNER
+void load_image(struct workload *w, struct scanner *in)
+{
+    struct image_header h;
+
+    if(in->size < sizeof h) {
+        fail(&w->failure, "ERROR - workload image '%s' is corrupt", in->filename);
+    }
+    memcpy(&h, in->map, sizeof h);
+    if(h.version != IMAGE_VERSION || h.layout != (int)IMAGE_LAYOUT) {
+        fail(&w->failure, "ERROR - '%s' is an incompatible workload image", in->filename);
+    }
+
+//  ENSURE THAT EVERY TABLE LIES WITHIN THE IMAGE, AND IS INTACT
+    long long   tables[][2] = {
+        { h.source_name,    1 },
+        { h.symbols,        h.nsymbols * (long long)sizeof w->symbols[0] },
+        { h.symbol_names,   h.symbol_names_size },
+        { h.symbol_hash,    h.symbol_hash_size * (long long)sizeof w->symbol_hash[0] },
+        { h.devices,        h.ndevices * (long long)sizeof w->devices[0] },
+        { h.commands,       h.ncommands * (long long)sizeof w->commands[0] },
+        { h.all_syscalls,   h.nall_syscalls * (long long)sizeof w->all_syscalls[0] },
+        { h.distributions,  h.ndistributions * (long long)sizeof w->distributions[0] },
+        { h.distribution_params,    h.ndistribution_params * (long long)sizeof w->distribution_params[0] },
+    };
+    for(int t=0 ; t<(int)(sizeof tables / sizeof tables[0]) ; ++t) {
+        if(tables[t][0] < (long long)sizeof h || tables[t][1] < 0 ||
+           tables[t][0] + tables[t][1] > (long long)in->size || tables[t][0] % 8 != 0) {
+            fail(&w->failure, "ERROR - workload image '%s' is corrupt", in->filename);
+        }
+    }
+    if(hash_bytes(HASH_SEED, in->map + sizeof h, in->size - sizeof h) != h.checksum ||
+       memchr(in->map + h.source_name, '\0', in->size - h.source_name) == NULL) {
+        fail(&w->failure, "ERROR - workload image '%s' is corrupt", in->filename);
+    }
+
+    const char  *source = in->map + h.source_name;
+
+    if(image_is_stale(w, &h, source)) {
+        fail(&w->failure, "ERROR - workload image '%s' is stale, as '%s' has changed",
+                in->filename, source);
+    }
+
+//  THE sysconfig FILE MUST HAVE DEFINED THE SAME DEVICES, IN THE SAME ORDER
+    struct symbol   *symbols        = (struct symbol *)(in->map + h.symbols);
+    char            *symbol_names   = in->map + h.symbol_names;
+    struct device   *devices        = (struct device *)(in->map + h.devices);
+
+    bool same   = (h.ndevices == w->ndevices);
+    for(int d=0 ; same && d<w->ndevices ; ++d) {
+        same    = strcmp(&symbol_names[symbols[devices[d].symbol].name], DEVICE_NAME(w, d)) == 0;
+    }
+    if(!same) {
+        fail(&w->failure, "ERROR - workload image '%s' was compiled for different devices", in->filename);
+    }
+
+//  USE THE IMAGE'S TABLES, KEEPING ONLY THE sysconfig's DEVICES
+    free(w->symbols);
+    free(w->symbol_names);
+    free(w->symbol_hash);
+    w->symbols              = symbols;
+    w->nsymbols             = h.nsymbols;
+    w->symbols_capacity     = h.nsymbols;
+    w->symbol_names         = symbol_names;
+    w->symbol_names_size    = h.symbol_names_size;
+    w->symbol_names_capacity= h.symbol_names_size;
+    w->symbol_hash          = (int *)(in->map + h.symbol_hash);
+    w->symbol_hash_size     = h.symbol_hash_size;
+    w->commands             = (struct command *)(in->map + h.commands);
+    w->ncommands            = h.ncommands;
+    w->commands_capacity    = h.ncommands;
+    w->all_syscalls         = (struct syscall *)(in->map + h.all_syscalls);
+    w->nall_syscalls        = h.nall_syscalls;
+    w->all_syscalls_capacity= h.nall_syscalls;
+    w->distributions        = (struct distribution *)(in->map + h.distributions);
+    w->ndistributions       = h.ndistributions;
+    w->distributions_capacity   = h.ndistributions;
+    w->distribution_params  = (long long *)(in->map + h.distribution_params);
+    w->ndistribution_params = h.ndistribution_params;
+    w->distribution_params_capacity = h.ndistribution_params;
+    FOREACH_DEVICE(w) {
+        w->devices[d].symbol    = devices[d].symbol;
+    }
+
+    free(w->source_name);
+    w->source_name          = strdup(source);
+    w->source_hash          = h.source_hash;
+    w->source_size          = h.source_size;
+    w->source_mtime         = h.source_mtime;
+
+//  THE WORKLOAD NOW OWNS THE MAPPING
+    w->image    = *in;
+    in->map     = NULL;
+}
+
+//  ----------------------------------------------------------------------
+
+void read_commands(struct workload *w, const char filename[])
+{
+    struct scanner  *in = &w->in;
+
+    if(w->image.map != NULL) {
+        fail(&w->failure, "ERROR - cannot read '%s' after a workload image", filename);
+    }
+    open_scanner(&w->failure, in, filename);
+    PROFILE_COUNT(&w->profile, PHASE_PARSE, in->size);
+
+//  THE commands MAY HAVE BEEN COMPILED INTO AN IMAGE
+    if(in->size >= 8 && memcmp(in->map, IMAGE_MAGIC, 8) == 0) {
+        if(w->ncommands > 0) {
+            fail(&w->failure, "ERROR - cannot load image '%s' after other commands", filename);
+        }
+        load_image(w, in);
+        return;
+    }
+    free(w->source_name);
+    w->source_name  = strdup(filename);
+    w->source_hash  = hash_bytes(HASH_SEED, in->map, in->size);
+    w->source_size  = in->size;
+    w->source_mtime = in->mtime;
+
+//  READ EACH LINE OF THE commands FILE
+    while(next_line(in)) {
+        if(*in->p == CHAR_COMMENT) {        // ignore this line
+            continue;
+        }
+
+//  FOUND A NEW COMMAND
+        if(isalnum((unsigned char)*in->p)) {
+            add_command(w, in);
+        }
+//  FOUND A NEW SYSCALL FOR THE CURRENT COMMAND
+        else if(*in->p == '\t' && w->ncommands > 0) {
+            add_syscall_to_command(w, in);
+        }
+        else {
+            scan_error(&w->failure, in, in->p, "line is not recognized");
+        }
+    }
+    close_scanner(in);
+    patch_commands(w);
+}
+
+//  NOT REQUIRED, BUT PROVIDES A CHECK THAT THINGS HAVE BEEN STORED CORRECTLY
+void dump_commands(struct workload *w)
+{
+    FOREACH_COMMAND(w) {
+        printf("%s\n", COMMAND_NAME(w, c));
+
+        for(int s=0 ; s<w->commands[c].nsyscalls ; ++s) {
+            struct syscall *sc  = COMMAND_SYSCALL(w, c, s);
+
+            switch (sc->which) {
+            case SYS_SPAWN:
+                printf("\t%lli\t%s\t%s\n",
+                    sc->when, syscalls[sc->which], COMMAND_NAME(w, sc->operand) );
+                break;
+
+            case SYS_READ:
+            case SYS_WRITE:
+                printf("\t%lli\t%s\t%s\t%lli\n",
+                    sc->when, syscalls[sc->which], DEVICE_NAME(w, sc->operand), sc->arg );
+                break;
+
+            case SYS_SLEEP:
+                printf("\t%lli\t%s\t%lli\n",
+                    sc->when, syscalls[sc->which], sc->arg );
+                break;
+
+            case SYS_WAIT:
+            case SYS_EXIT:
+                printf("\t%lli\t%s\n",
+                    sc->when, syscalls[sc->which] );
+                break;
+            }
+        }
+    }
+}
+
+//  ----------------------------------------------------------------------
+
+//  AN ARRAY AND FUNCTIONS TO MANAGE THE SYSTEM'S WAITING QUEUE
+
+//  A WAITING PROCESS IS ADDED TO THE HEAP childless WHEN ITS LAST CHILD EXITS,
+//  KEYED BY WHEN IT BEGAN WAITING, SO THAT ONLY THOSE PROCESSES ARE VISITED
+//  AND THEY ARE UNBLOCKED IN THE ORDER OF THE WAITING QUEUE.
+
+void init_WAITING_queue(struct simulation *sim)
+{
+    init_queue(&sim->WAITING_queue);
+    sim->nwaiting_childless = 0;
+    sim->nwaits             = 0;
+}
+
+void append_to_WAITING_queue(struct simulation *sim, int proc_on_CPU)
+{
+    TRACE(sim, EVENT_WAITING, sim->processes[proc_on_CPU].pid, UNKNOWN, 0, 0, 0);
+    trace_flush(sim, proc_on_CPU);
+
+    append_to_queue(sim, &sim->WAITING_queue, proc_on_CPU);
+    sim->processes[proc_on_CPU].waiting_seq = sim->nwaits++;
+    enter_state(sim, proc_on_CPU, STATE_WAITING);
+}
+
+//  REMEMBER IF A WAITING PROCESS HAS JUST LOST ITS LAST CHILD
+void child_has_exited(struct simulation *sim, int parent)
+{
+    struct process *p   = &sim->processes[parent];
+
+    if(p->state == STATE_WAITING && p->nchildren == 0) {
+        struct keyed    new = { parent, p->waiting_seq, 0 };
+
+        push_keyed(&sim->failure, &sim->childless, &sim->childless_capacity,
+                    sim->nwaiting_childless++, new);
+    }
+}
+
+//  UNBLOCK, IN QUEUE ORDER, ALL WAITING PROCESSES WHOSE CHILDREN HAVE EXITED
+void unblock_WAITING(struct simulation *sim)
+{
+    if(sim->nwaiting_childless == 0) {          // no need to search
+        return;
+    }
+    PROFILE_BEGIN();
+    while(sim->nwaiting_childless > 0) {
+        int proc    = pop_keyed(sim->childless, sim->nwaiting_childless--).index;
+
+        PROFILE_COUNT(&sim->profile, PHASE_WAITING, 1);
+        remove_from_queue(sim, &sim->WAITING_queue, proc);
+        append_to_READY_queue(sim, proc, STATE_WAITING);
+        advance_time(sim, TIME_CORE_STATE_TRANSITIONS);
+    }
+    PROFILE_END(&sim->profile, PHASE_WAITING);
+}
+
+//  ----------------------------------------------------------------------
+
+//  A BINARY MIN-HEAP AND FUNCTIONS TO MANAGE THE SYSTEM'S SLEEPING QUEUE.
+//  SLEEPERS ARE ORDERED BY WHEN THEY AWAKEN, THEN BY WHEN THEY BEGAN TO
+//  SLEEP, SO THE NEXT TO AWAKEN IS ALWAYS AT SLEEPING_queue[0].
+
+struct sleeper {
+    int         proc;                   // index into processes[]
+    usecs_t     until;                  // when the process awakens
+    long long   seq;                    // order in which sleeping began
+};
+
+void init_SLEEPING_queue(struct simulation *sim)
+{
+    sim->nsleeping  = 0;
+    sim->nsleeps    = 0;
+}
+
+bool sleeper_before(struct sleeper *a, struct sleeper *b)
+{
+    return a->until < b->until || (a->until == b->until && a->seq < b->seq);
+}
+
+void append_to_SLEEPING_queue(struct simulation *sim, int proc_on_CPU, usecs_t duration)
+{
+    TRACE(sim, EVENT_SLEEPING, sim->processes[proc_on_CPU].pid, UNKNOWN, duration, 0, 0);
+
+    enter_state(sim, proc_on_CPU, STATE_SLEEPING);
+
+    sim->SLEEPING_queue = grow_table(&sim->failure, sim->SLEEPING_queue, &sim->SLEEPING_queue_capacity,
+                                    sim->nsleeping+1, sizeof sim->SLEEPING_queue[0]);
+    struct sleeper  *heap   = sim->SLEEPING_queue;
+    struct sleeper  new;
+
+    new.proc    = proc_on_CPU;
+//  NOTE WE'RE STORING THE TIME THE PROCESS WAKES UP, NOT JUST THE SLEEPING TIME
+    new.until   = sim->USECS_SINCE_REBOOT+duration+1;
+    new.seq     = sim->nsleeps++;
+
+//  SIFT THE NEW SLEEPER UP FROM THE BOTTOM OF THE HEAP
+    int s       = sim->nsleeping++;
+    while(s > 0 && sleeper_before(&new, &heap[(s-1)/2])) {
+        heap[s] = heap[(s-1)/2];
+        s       = (s-1)/2;
+    }
+    heap[s]     = new;
+}
+
+//  REMOVE THE NEXT SLEEPER TO AWAKEN FROM THE TOP OF THE HEAP
+struct sleeper pop_SLEEPING_queue(struct simulation *sim)
+{
+    struct sleeper  *heap   = sim->SLEEPING_queue;
+    struct sleeper  top     = heap[0];
+    struct sleeper  last    = heap[--sim->nsleeping];
+    int             n       = sim->nsleeping;
+
+//  SIFT THE LAST SLEEPER DOWN FROM THE TOP OF THE HEAP
+    int s   = 0;
+    for(;;) {
+        int child   = 2*s + 1;
+
+        if(child >= n) {
+            break;
+        }
+        if(child+1 < n && sleeper_before(&heap[child+1], &heap[child])) {
+            ++child;
+        }
+        if(!sleeper_before(&heap[child], &last)) {
+            break;
+        }
+        heap[s] = heap[child];
+        s       = child;
+    }
+    heap[s] = last;
+    return top;
+}
+
+int compare_sleep_order(const void *a, const void *b)
+{
+    long long seq_a = ((const struct sleeper *)a)->seq;
+    long long seq_b = ((const struct sleeper *)b)->seq;
+
+    return (seq_a > seq_b) - (seq_a < seq_b);
+}
+
+//  AWAKEN ALL SLEEPERS WHOSE TIME HAS COME, IN THE ORDER THAT THEY FELL ASLEEP
+void unblock_SLEEPING(struct simulation *sim)
+{
+    usecs_t ORIG_USECS  = sim->USECS_SINCE_REBOOT;
+    int     nawakening  = 0;
+    PROFILE_BEGIN();
+
+    while(sim->nsleeping > 0 && sim->SLEEPING_queue[0].until <= ORIG_USECS) {
+        sim->awakening  = grow_table(&sim->failure, sim->awakening, &sim->awakening_capacity,
+                                    nawakening+1, sizeof sim->awakening[0]);
+        sim->awakening[nawakening++]    = pop_SLEEPING_queue(sim);
+    }
+    if(nawakening > 1) {
+        qsort(sim->awakening, nawakening, sizeof sim->awakening[0], compare_sleep_order);
+    }
+
+    for(int a=0 ; a<nawakening ; ++a) {
+        append_to_READY_queue(sim, sim->awakening[a].proc, STATE_SLEEPING);
+        advance_time(sim, TIME_CORE_STATE_TRANSITIONS);
+    }
+    PROFILE_COUNT(&sim->profile, PHASE_SLEEPING, nawakening);
+    PROFILE_END(&sim->profile, PHASE_SLEEPING);
+}
+
+//  ----------------------------------------------------------------------
+
+//  WHILE NOTHING CAN CHANGE, EACH 1usec TICK OF A CORE IS WASTED.
+//  FIND THE NEXT TICK AT WHICH THE CORE CAN DO SOMETHING: ITS RUNNING
+//  PROCESS'S NEXT SYSTEM-CALL OR TIMEQUANTUM EXPIRY, OR (WHEN THE CORE IS
+//  IDLE) THE NEXT SLEEPER TO AWAKEN OR I/O TO COMPLETE.
+//  WHEN TRACED, THE SKIPPED TICKS ARE RECORDED AS A SINGLE SPAN.
+
+usecs_t next_eventful_usec(struct simulation *sim, int k)
+{
+    struct core *core   = &sim->cores[k];
+    usecs_t     now     = core->next_usec;
+
+//  A RUNNING PROCESS COMPUTES UNTIL ITS NEXT SYSTEM-CALL OR ITS TQ EXPIRES
+    if(core->proc_on_CPU != UNKNOWN) {
+        struct process *proc    = &sim->processes[core->proc_on_CPU];
+        usecs_t skip            = LLONG_MAX;
+
+        if(proc->syscall_at != NO_MORE_SYSCALLS && proc->syscall_at >= proc->time_on_CPU) {
+            skip        = proc->syscall_at - proc->time_on_CPU;
+        }
+        if(core->timequantum_expires - now < skip) {
+            skip        = core->timequantum_expires - now;
+        }
+        return (skip > 0) ? now+skip : now;
+    }
+
+//  AN IDLE CORE HAS WORK TO DO NOW?
+    if(core->nready > 0 || can_steal(sim, k) || sim->nwaiting_childless > 0 ||
+       can_start_IO(sim)) {
+        return now;
+    }
+
+//  OTHERWISE, IT REMAINS IDLE UNTIL A SLEEPER AWAKENS, AN I/O COMPLETES,
+//  OR A PROCESS ARRIVES
+    usecs_t next    = next_IO_completion(sim);
+
+    if(sim->nsleeping > 0 && sim->SLEEPING_queue[0].until < next) {
+        next    = sim->SLEEPING_queue[0].until;
+    }
+    if(sim->next_arrival < next) {
+        next    = sim->next_arrival;
+    }
+    return (next > now) ? next : now;
+}
+
+//  A CORE SKIPS ITS UNEVENTFUL TICKS, UNTIL THE GIVEN TIME
+void skip_uneventful_usecs(struct simulation *sim, int k, usecs_t until)
+{
+    struct core *core   = &sim->cores[k];
+    PROFILE_BEGIN();
+
+    if(until > core->next_usec) {
+        PROFILE_COUNT(&sim->profile, PHASE_SKIP, until - core->next_usec);
+        if(sim->tracer != NULL) {
+            trace_span(sim, k, core->next_usec, until);
+        }
+        if(core->proc_on_CPU != UNKNOWN) {
+            sim->processes[core->proc_on_CPU].time_on_CPU   += until - core->next_usec;
+            core->time_on_CPU                               += until - core->next_usec;
+        }
+        core->next_usec = until;
+    }
+    PROFILE_END(&sim->profile, PHASE_SKIP);
+}
+
+//  THE CORES TICK TOGETHER, EACH TICK BEING EXECUTED BY EACH CORE IN TURN.
+//  FIND THE CORE WITH THE EARLIEST EVENTFUL TICK (LOWEST-NUMBERED, IF TIED).
+//  ALL TICKS OF ALL CORES BEFORE IT ARE UNEVENTFUL, AND MAY BE SKIPPED.
+
+int next_eventful_core(struct simulation *sim)
+{
+    int     next    = 0;
+    usecs_t when    = next_eventful_usec(sim, 0);
+
+    PROFILE_COUNT(&sim->profile, PHASE_SELECT, sim->ncores);
+    for(int k=1 ; k<sim->ncores ; ++k) {
+        usecs_t w   = next_eventful_usec(sim, k);
+
+        if(w < when) {
+            next    = k;
+            when    = w;
+        }
+    }
+//  NOTHING CAN EVER HAPPEN (WHICH SHOULD NOT OCCUR) - JUST KEEP TICKING
+    if(when == LLONG_MAX) {
+        when    = sim->cores[next].next_usec;
+    }
+    FOREACH_CORE(sim) {
+        skip_uneventful_usecs(sim, k, (k < next) ? when+1 : when);
+    }
+    return next;
+}
+
+//  ----------------------------------------------------------------------
+
+//  INDEXING THE CORES.  WITH MANY CORES, EVALUATING AND SKIPPING EVERY CORE
+//  FOR EVERY EVENT COSTS FAR MORE THAN THE EVENT ITSELF.  BUT A BUSY CORE'S
+//  NEXT EVENTFUL TICK (ITS PROCESS'S NEXT SYSTEM-CALL, OR ITS TQ EXPIRING)
+//  CHANGES ONLY WHEN IT EXECUTES AN EVENT ITSELF, SO BUSY CORES ARE KEPT IN A
+//  HEAP KEYED BY THAT TICK, AND ONLY IDLE CORES (WHICH DEPEND ON THE WHOLE
+//  SYSTEM) ARE EVALUATED FOR EACH EVENT.
+//
+//  NOR ARE A CORE'S UNEVENTFUL TICKS SKIPPED UNTIL IT IS NEXT NEEDED.  EACH
+//  EVENT RECORDS ITS frontier (usec AND core), AND A CORE CATCHES UP TO THE
+//  LAST frontier EXACTLY AS IF IT HAD BEEN SKIPPED FOR EVERY EVENT, SO THE SAME
+//  EVENTS EXECUTE IN THE SAME ORDER.  ALL CORES CATCH UP BEFORE ms_step()
+//  RETURNS.  A TRACED SIMULATION, WHICH RECORDS EACH SKIP AS IT HAPPENS, AND
+//  A STEP OF FEWER EVENTS THAN CORES, ARE NOT INDEXED.
+
+//  A CORE SKIPS ITS TICKS UP TO THE LAST EVENT: THOSE BEFORE THE frontier
+//  CORE UP TO AND INCLUDING ITS usec, THE OTHERS UP TO BUT EXCLUDING IT
+void catch_up_core(struct simulation *sim, int k)
+{
+    skip_uneventful_usecs(sim, k, sim->frontier_usec + (k < sim->frontier_core));
+}
+
+void add_idle_core(struct simulation *sim, int k)
+{
+    sim->idle_index[k]              = sim->nidle;
+    sim->idle_cores[sim->nidle++]   = k;
+}
+
+void remove_idle_core(struct simulation *sim, int k)
+{
+    int last                        = sim->idle_cores[--sim->nidle];
+
+    sim->idle_cores[sim->idle_index[k]] = last;
+    sim->idle_index[last]           = sim->idle_index[k];
+}
+
+void add_busy_core(struct simulation *sim, int k)
+{
+    struct keyed    new = { k, next_eventful_usec(sim, k), k };
+
+    push_keyed(&sim->failure, &sim->busy_cores, &sim->busy_cores_capacity, sim->nbusy, new);
+    ++sim->nbusy;
+}
+
+void index_cores(struct simulation *sim)
+{
+    int capacity    = sim->idle_capacity;
+
+    sim->idle_cores = grow_table(&sim->failure, sim->idle_cores, &capacity,
+                                    sim->ncores, sizeof sim->idle_cores[0]);
+    sim->idle_index = grow_table(&sim->failure, sim->idle_index, &sim->idle_capacity,
+                                    sim->ncores, sizeof sim->idle_index[0]);
+    sim->nidle      = 0;
+    sim->nbusy      = 0;
+    FOREACH_CORE(sim) {
+        if(sim->cores[k].proc_on_CPU == UNKNOWN) {
+            add_idle_core(sim, k);
+        }
+        else {
+            add_busy_core(sim, k);
+        }
+    }
+    sim->indexed    = true;
+}
+
+void unindex_cores(struct simulation *sim)
+{
+    FOREACH_CORE(sim) {
+        catch_up_core(sim, k);
+    }
+    sim->indexed    = false;
+}
+
+//  THE EARLIEST BUSY CORE, OR ANY EARLIER IDLE CORE, HAS THE NEXT EVENT
+int next_indexed_core(struct simulation *sim)
+{
+    int     next    = UNKNOWN;
+    usecs_t when    = LLONG_MAX;
+
+    if(sim->nbusy > 0) {
+        next    = sim->busy_cores[0].index;
+        when    = sim->busy_cores[0].key;
+    }
+    PROFILE_COUNT(&sim->profile, PHASE_SELECT, sim->nidle + (sim->nbusy > 0));
+    for(int i=0 ; i<sim->nidle ; ++i) {
+        int k   = sim->idle_cores[i];
+
+        catch_up_core(sim, k);
+
+        usecs_t w   = next_eventful_usec(sim, k);
+
+        if(w < when || (w == when && k < next)) {
+            next    = k;
+            when    = w;
+        }
+    }
+//  NOTHING CAN EVER HAPPEN (WHICH SHOULD NOT OCCUR) - JUST KEEP TICKING
+    if(when == LLONG_MAX) {
+        next    = 0;
+        catch_up_core(sim, next);
+        when    = sim->cores[next].next_usec;
+    }
+    sim->frontier_usec  = when;
+    sim->frontier_core  = next;
+    catch_up_core(sim, next);
+
+    if(sim->cores[next].proc_on_CPU == UNKNOWN) {
+        remove_idle_core(sim, next);
+    }
+    else {
+        pop_keyed(sim->busy_cores, sim->nbusy--);
+    }
+    return next;
+}
+
+//  THE CORE THAT EXECUTED THE LAST EVENT IS NOW EITHER BUSY OR IDLE
+void reindex_core(struct simulation *sim, int k)
+{
+    if(sim->cores[k].proc_on_CPU == UNKNOWN) {
+        add_idle_core(sim, k);
+    }
+    else {
+        add_busy_core(sim, k);
+    }
+}
+
+//  ----------------------------------------------------------------------
+
+//  AN OPEN SYSTEM'S PROCESSES ARRIVE AS RECORDS OF "usecs command", EACH
+//  READ ONLY WHEN THE PREVIOUS ONE HAS ARRIVED, SO AN ENDLESS STREAM (FROM A
+//  PIPE OR FIFO) NEEDS NO MORE MEMORY THAN ITS LONGEST RECORD.  THE RECORDS'
+//  TIMES MUST NOT DECREASE.  ARRIVALS, LIKE AWAKENING SLEEPERS, ARE ADMITTED
+//  BY AN IDLE CORE, AND EACH IS SPAWNED WITHOUT A PARENT.
+
+void arrivals_error(struct simulation *sim, char *fmt, ...)
+{
+    char    message[BUFSIZ];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(message, sizeof message, fmt, ap);
+    va_end(ap);
+    fail(&sim->failure, "ERROR - line %lli of arrivals: %s", sim->arrivals_lc, message);
+}
+
+//  READ THE NEXT ARRIVAL, IGNORING BLANK LINES AND COMMENTS
+void read_next_arrival(struct simulation *sim)
+{
+    while(getline(&sim->arrival_line, &sim->arrival_line_size, sim->arrivals) >= 0) {
+        char    *p  = sim->arrival_line;
+
+        ++sim->arrivals_lc;
+        while(is_blank(*p)) {
+            ++p;
+        }
+        if(*p == '\0' || *p == '\n' || *p == CHAR_COMMENT) {
+            continue;
+        }
+
+//  THE TIME, WHICH MAY BE FOLLOWED BY ITS UNITS, THEN THE COMMAND'S NAME
+        char        *end;
+        long long   usecs   = strtoll(p, &end, 10);
+
+        if(end == p || usecs < 0 || usecs == LLONG_MAX) {
+            arrivals_error(sim, "expected a time");
+        }
+        if(usecs < sim->next_arrival && sim->narrived > 0) {
+            arrivals_error(sim, "arrivals must not go back in time");
+        }
+        for(p=end ; isalpha((unsigned char)*p) ; ++p) {
+        }
+        while(is_blank(*p)) {
+            ++p;
+        }
+
+        char    *name   = p;
+        while(*p != '\0' && *p != '\n' && !is_blank(*p)) {
+            ++p;
+        }
+
+        int     sym     = find_symbol(sim->w, name, p - name);
+
+        if(sym == UNKNOWN || sim->w->symbols[sym].command == UNKNOWN) {
+            arrivals_error(sim, "command '%.*s' not found", (int)(p - name), name);
+        }
+        while(is_blank(*p)) {
+            ++p;
+        }
+        if(*p != '\0' && *p != '\n') {
+            arrivals_error(sim, "unexpected text at end of line");
+        }
+        sim->next_arrival           = usecs;
+        sim->next_arrival_command   = sim->w->symbols[sym].command;
+        return;
+    }
+    if(ferror(sim->arrivals)) {
+        fail(&sim->failure, "ERROR - cannot read arrivals");
+    }
+    sim->next_arrival   = LLONG_MAX;            // no more will arrive
+}
+
+//  SPAWN EACH PROCESS THAT HAS ARRIVED BY NOW
+void admit_arrivals(struct simulation *sim)
+{
+    PROFILE_BEGIN();
+
+    while(sim->next_arrival <= sim->USECS_SINCE_REBOOT) {
+        spawn_process(sim, sim->next_arrival_command, UNKNOWN);
+        ++sim->narrived;
+        read_next_arrival(sim);
+        PROFILE_COUNT(&sim->profile, PHASE_ARRIVALS, 1);
+    }
+    PROFILE_END(&sim->profile, PHASE_ARRIVALS);
+}
+
+//  A SIMULATION CONTINUES WHILE PROCESSES ARE RUNNING, OR ARE STILL TO ARRIVE
+static inline bool processes_remain(struct simulation *sim)
+{
+    return sim->nprocesses > 0 || sim->next_arrival != LLONG_MAX;
+}
+
+//  ----------------------------------------------------------------------
+
+//  INITIALIZE THE SYSTEM, AND SPAWN THE FIRST COMMAND IN command-file
+//  (OR, IN AN OPEN SYSTEM, THOSE ARRIVING AT TIME 0)
+void reboot(struct simulation *sim)
+{
+    if(sim->w->ncommands == 0) {
+        fail(&sim->failure, "ERROR - no commands to execute");
+    }
+    init_processes(sim);
+    init_SLEEPING_queue(sim);
+    init_WAITING_queue(sim);
+    init_devices_and_IO_BLOCKED_queues(sim);
+    init_cores(sim);
+    init_metrics(sim);
+
+    sim->USECS_SINCE_REBOOT = 0;
+    sim->total_time_on_CPU  = 0;
+    if(sim->trace != NULL) {
+        open_tracer(sim, sim->trace, sim->trace_format);
+    }
+
+//  THE REAL-WORLD TIME IS NOT PART OF THE PROJECT, JUST REPORTED IN THE TRACE
+    TRACE(sim, EVENT_REBOOT, UNKNOWN, UNKNOWN, time(NULL), sim->timequantum, 0);
+    trace_flush(sim, UNKNOWN);
+    if(sim->arrivals != NULL) {
+        read_next_arrival(sim);
+        admit_arrivals(sim);
+    }
+    else {
+        spawn_process(sim, 0, UNKNOWN);
+        ++sim->narrived;
+    }
+    trace_flush(sim, UNKNOWN);
+    sim->started    = true;
+}
+
+//  EXECUTE THE NEXT EVENTFUL TICK, OF THE CORE WHOSE TICK IS EARLIEST
+void execute_next_event(struct simulation *sim)
+{
+    const struct workload *w    = sim->w;
+
+    {
+        PROFILE_BEGIN();
+        sim->current_core   = sim->indexed ? next_indexed_core(sim) : next_eventful_core(sim);
+        PROFILE_END(&sim->profile, PHASE_SELECT);
+    }
+
+    struct core *core       = &sim->cores[sim->current_core];
+    sim->USECS_SINCE_REBOOT = core->next_usec;
+    ++sim->nevents;
+
+//  IS A PROCESS RUNNING ON THE CPU?
+    if(core->proc_on_CPU != UNKNOWN) {
+        int proc_on_CPU = core->proc_on_CPU;
+        struct process *p   = &sim->processes[proc_on_CPU];
+
+//  THE RUNNING PROCESS ISSUES A SYSTEM-CALL, IT WILL LOSE THE CPU
+        if(p->time_on_CPU == p->syscall_at) {
+            PROFILE_BEGIN();
+            const struct syscall *sc    = &w->all_syscalls[p->next_syscall++];
+            find_syscall_at(sim, proc_on_CPU);
+
+            switch (sc->which) {
+                case SYS_SPAWN:
+                    spawn_process(sim, sc->operand, proc_on_CPU);
+                    ++sim->processes[proc_on_CPU].nchildren;
+                    append_to_READY_queue(sim, proc_on_CPU, STATE_RUNNING);
+                    advance_time(sim, TIME_CORE_STATE_TRANSITIONS);
+                    break;
+
+                case SYS_READ:
+                case SYS_WRITE:
+                    append_to_IO_BLOCKED_queue(sim, proc_on_CPU, sc->which, sc->operand,
+                                syscall_value(sim, proc_on_CPU, sc->arg, sc->arg_distribution));
+                    break;
+
+                case SYS_SLEEP:
+                    append_to_SLEEPING_queue(sim, proc_on_CPU,
+                                syscall_value(sim, proc_on_CPU, sc->arg, sc->arg_distribution));
+                    advance_time(sim, TIME_CORE_STATE_TRANSITIONS);
+                    break;
+
+                case SYS_WAIT:
+                    if(sim->processes[proc_on_CPU].nchildren == 0) {
+                        TRACE(sim, EVENT_WAIT_NO_CHILDREN, UNKNOWN, UNKNOWN, 0, 0, 0);
+                        append_to_READY_queue(sim, proc_on_CPU, STATE_RUNNING);
+                        trace_flush(sim, proc_on_CPU);
+                    }
+                    else {
+                        append_to_WAITING_queue(sim, proc_on_CPU);
+                    }
+                    advance_time(sim, TIME_CORE_STATE_TRANSITIONS);
+                    break;
+
+                case SYS_EXIT:
+                    sim->total_time_on_CPU  += sim->processes[proc_on_CPU].time_on_CPU;
+                    exit_process(sim, proc_on_CPU);
+                    break;
+
+                default:
+                    fail(&sim->failure, "ERROR - unknown syscall %i", sc->which);
+                    break;
+            }
+//  EACH SYSTEM-CALL HAS RESULTED IN ITS PROCESS LEAVING THE CPU
+            core->proc_on_CPU   = UNKNOWN;
+            trace_flush(sim, UNKNOWN);
+            PROFILE_END(&sim->profile, PHASE_SYSCALL);
+        }
+
+//  IF A PROCESS IS ON THE CPU...
+        if(core->proc_on_CPU != UNKNOWN) {
+
+//  PROCESS ON CPU HAS CONSUMED SOME CPU (COMPUTATION) TIME
+            ++sim->processes[proc_on_CPU].time_on_CPU;
+            ++core->time_on_CPU;
+            TRACE(sim, EVENT_COMPUTE, sim->processes[proc_on_CPU].pid,
+                  sim->processes[proc_on_CPU].command, 0, 0, 0);
+            trace_flush(sim, proc_on_CPU);
+
+//  HAS THE RUNNING PROCESS'S TIME QUANTUM EXPIRED?
+            if(sim->USECS_SINCE_REBOOT >= core->timequantum_expires) {
+                TRACE(sim, EVENT_TQ_EXPIRED, sim->processes[proc_on_CPU].pid, UNKNOWN, 0, 0, 0);
+                if(sim->scheduler->expired != NULL) {
+                    sim->scheduler->expired(sim, proc_on_CPU);
+                }
+                append_to_READY_queue(sim, proc_on_CPU, STATE_RUNNING);
+                core->proc_on_CPU   = UNKNOWN;
+                advance_time(sim, TIME_CORE_STATE_TRANSITIONS);
+            }
+        }
+    }
+
+//  IF CPU IS NOW IDLE, IT ADMITS ANY PROCESSES THAT HAVE ARRIVED
+    if(core->proc_on_CPU == UNKNOWN && sim->next_arrival <= sim->USECS_SINCE_REBOOT) {
+        admit_arrivals(sim);
+    }
+
+//  IF CPU IS NOW IDLE AND PROCESSES REMAIN....
+    if(core->proc_on_CPU == UNKNOWN && sim->nprocesses > 0) {
+        unblock_SLEEPING(sim);
+        unblock_WAITING(sim);
+        unblock_completed_IO(sim);
+        start_pending_IO(sim);
+
+//  IDLE CPU CAN RECEIVE THE FIRST READY PROCESS, OR STEAL ONE
+        if(core->nready > 0 || can_steal(sim, sim->current_core)) {
+            core->proc_on_CPU           = dequeue_READY_queue(sim);
+            core->timequantum_expires   = sim->USECS_SINCE_REBOOT +                 // new TQ
+                                    sim->scheduler->timequantum(sim, core, core->proc_on_CPU);
+
+            TRACE(sim, EVENT_ON_CPU, sim->processes[core->proc_on_CPU].pid, UNKNOWN, 0, 0, 0);
+            trace_flush(sim, core->proc_on_CPU);
+        }
+
+//  STILL IDLE?
+        if(core->proc_on_CPU == UNKNOWN) {
+            TRACE(sim, EVENT_IDLE, UNKNOWN, UNKNOWN, 0, 0, 0);
+            trace_flush(sim, UNKNOWN);
+        }
+    }
+    core->next_usec     = sim->USECS_SINCE_REBOOT+1;
+    if(sim->indexed) {
+        reindex_core(sim, sim->current_core);
+    }
+}
+
+//  ----------------------------------------------------------------------
+
+//  AT ANY EVENT BOUNDARY, A SIMULATION'S COMPLETE STATE MAY BE SAVED TO A
+//  SNAPSHOT AND LATER RESTORED, OR FORKED INTO A NEW SIMULATION IN MEMORY,
+//  SO THAT MANY CONTINUATIONS MAY SHARE ONE SIMULATED PREFIX.  THE NUMBER
+//  OF cores AND buses, THE scheduler, AND THE arbitration ARE PART OF THE
+//  STATE; THE timequantum, steal POLICY, AND stealcost ARE TAKEN FROM THE
+//  CONTINUATION'S OWN CONFIGURATION, AND SO MAY DIFFER.
+
+#define SNAPSHOT_MAGIC          "MYSCHEDS"
+#define SNAPSHOT_VERSION        8
+#define SNAPSHOT_LAYOUT         ((long long)sizeof(struct process) | (long long)sizeof(struct core) << 16 | \
+                                 (long long)sizeof(struct bus) << 32 | (long long)sizeof(struct sleeper) << 48)
+
+struct snapshot_header {
+    char                magic[8];
+    int                 version;
+    long long           layout;             // the sizes of its tables' entries
+    unsigned long long  checksum;           // of all of its tables
+
+//  THE WORKLOAD BEING EXECUTED
+    unsigned long long  source_hash;
+    int                 ndevices, ncommands, nall_syscalls;
+
+    int                 ncores, nbuses, scheduler, arbitration;
+    int                 nprocesses, nslots, first_free_slot;
+    int                 nblocked, current_core, nready, nwaiting_childless, nsleeping;
+    int                 finished;
+    struct queue        WAITING_queue;
+    usecs_t             USECS_SINCE_REBOOT, total_time_on_CPU;
+    long long           next_pid, nspawned, nevents, nenqueued, nsleeps, nwaits, narrived, ncoalesced;
+};
+
+//  EACH TABLE OF A SIMULATION'S STATE, AND HOW MANY OF ITS ENTRIES ARE IN USE
+struct state_table {
+    void        **table;
+    int         *capacity;                  // or NULL if it never grows
+    int         n;
+    size_t      size;
+};
+
+#define STATE_TABLES            9           // followed by each bus's, then each core's
+
+//  DESCRIBE THE t'th TABLE, RETURNING false AFTER THE LAST.  THE NUMBER OF
+//  ENTRIES IN EACH BUS'S AND EACH CORE'S TABLE IS HELD IN THE EARLIER TABLES.
+bool state_table(struct simulation *sim, int t, struct state_table *st)
+{
+    switch (t) {
+        case 0: *st = (struct state_table){ (void **)&sim->processes, &sim->processes_capacity,
+                                            sim->nslots, sizeof sim->processes[0] };
+                return true;
+        case 1: *st = (struct state_table){ (void **)&sim->IO_BLOCKED_queues, NULL,
+                                            sim->w->ndevices, sizeof sim->IO_BLOCKED_queues[0] };
+                return true;
+        case 2: *st = (struct state_table){ (void **)&sim->buses, NULL,
+                                            sim->nbuses, sizeof sim->buses[0] };
+                return true;
+        case 3: *st = (struct state_table){ (void **)&sim->cores, &sim->cores_capacity,
+                                            sim->ncores, sizeof sim->cores[0] };
+                return true;
+        case 4: *st = (struct state_table){ (void **)&sim->SLEEPING_queue, &sim->SLEEPING_queue_capacity,
+                                            sim->nsleeping, sizeof sim->SLEEPING_queue[0] };
+                return true;
+        case 5: *st = (struct state_table){ (void **)&sim->metrics, NULL,
+                                            MS_NMETRICS, sizeof sim->metrics[0] };
+                return true;
+        case 6: *st = (struct state_table){ (void **)&sim->device_metrics, NULL,
+                                            sim->w->ndevices*MS_NDEVICE_METRICS, sizeof sim->device_metrics[0] };
+                return true;
+        case 7: *st = (struct state_table){ (void **)&sim->histories, &sim->histories_capacity,
+                                            sim->nslots, sizeof sim->histories[0] };
+                return true;
+        case 8: *st = (struct state_table){ (void **)&sim->childless, &sim->childless_capacity,
+                                            sim->nwaiting_childless, sizeof sim->childless[0] };
+                return true;
+    }
+    t  -= STATE_TABLES;
+    if(t < sim->nbuses) {
+        struct bus  *bus    = &sim->buses[t];
+
+        *st = (struct state_table){ (void **)&bus->pending, &bus->pending_capacity,
+                                    bus->npending, sizeof bus->pending[0] };
+        return true;
+    }
+    t  -= sim->nbuses;
+    if(t < sim->ncores) {
+        struct core *core   = &sim->cores[t];
+
+//  ONLY THE SCHEDULERS STEALING FROM A HEAP KEEP THEIR READY QUEUES IN ONE
+        *st = (struct state_table){ (void **)&core->READY_heap, &core->READY_heap_capacity,
+                                    (sim->scheduler->steal == heap_steal) ? core->nready : 0,
+                                    sizeof core->READY_heap[0] };
+        return true;
+    }
+    return false;
+}
+
+unsigned long long state_checksum(struct simulation *sim)
+{
+    unsigned long long  hash    = HASH_SEED;
+    struct state_table  st;
+
+    for(int t=0 ; state_table(sim, t, &st) ; ++t) {
+        hash    = hash_bytes(hash, *st.table, st.n * st.size);
+    }
+    return hash;
+}
+
+void get_snapshot_header(struct simulation *sim, struct snapshot_header *h)
+{
+    memset(h, 0, sizeof *h);
+    memcpy(h->magic, SNAPSHOT_MAGIC, sizeof h->magic);
+    h->version              = SNAPSHOT_VERSION;
+    h->layout               = SNAPSHOT_LAYOUT;
+    h->checksum             = state_checksum(sim);
+
+    h->source_hash          = sim->w->source_hash;
+    h->ndevices             = sim->w->ndevices;
+    h->ncommands            = sim->w->ncommands;
+    h->nall_syscalls        = sim->w->nall_syscalls;
+
+    h->ncores               = sim->ncores;
+    h->nbuses               = sim->nbuses;
+    h->scheduler            = sim->scheduler - schedulers;
+    h->arbitration          = sim->arbitration;
+    h->nprocesses           = sim->nprocesses;
+    h->nslots               = sim->nslots;
+    h->first_free_slot      = sim->first_free_slot;
+    h->next_pid             = sim->next_pid;
+    h->nspawned             = sim->nspawned;
+    h->nblocked             = sim->nblocked;
+    h->current_core         = sim->current_core;
+    h->nready               = sim->nready;
+    h->nwaiting_childless   = sim->nwaiting_childless;
+    h->nsleeping            = sim->nsleeping;
+    h->finished             = sim->finished;
+    h->WAITING_queue        = sim->WAITING_queue;
+    h->USECS_SINCE_REBOOT   = sim->USECS_SINCE_REBOOT;
+    h->total_time_on_CPU    = sim->total_time_on_CPU;
+    h->nevents              = sim->nevents;
+    h->nenqueued            = sim->nenqueued;
+    h->nsleeps              = sim->nsleeps;
+    h->nwaits               = sim->nwaits;
+    h->narrived             = sim->narrived;
+    h->ncoalesced           = sim->ncoalesced;
+}
+
+//  A SNAPSHOT MAY ONLY BE RESTORED INTO A NEW SIMULATION OF THE SAME WORKLOAD
+void set_from_snapshot_header(struct simulation *sim, const struct snapshot_header *h)
+{
+    const struct workload *w    = sim->w;
+
+    if(sim->started) {
+        fail(&sim->failure, "ERROR - a snapshot can only be restored into a new simulation");
+    }
+    if(h->source_hash != w->source_hash || h->ndevices != w->ndevices ||
+       h->ncommands != w->ncommands || h->nall_syscalls != w->nall_syscalls) {
+        fail(&sim->failure, "ERROR - the snapshot is of a different workload");
+    }
+    if(h->ncores < 1 || h->nbuses < 1 || h->scheduler < 0 || h->scheduler > SCHEDULER_PRIORITY ||
+       h->arbitration < 0 || h->arbitration > ARBITRATE_DEADLINE ||
+       h->nslots < 0 || h->nslots > MAX_RUNNING_PROCESSES || h->nsleeping < 0 || h->nsleeping > h->nslots ||
+       h->nwaiting_childless < 0 || h->nwaiting_childless > h->nslots) {
+        fail(&sim->failure, "ERROR - the snapshot is corrupt");
+    }
+    sim->ncores             = h->ncores;
+    sim->nbuses             = h->nbuses;
+    sim->scheduler          = &schedulers[h->scheduler];
+    sim->arbitration        = h->arbitration;
+    sim->nprocesses         = h->nprocesses;
+    sim->nslots             = h->nslots;
+    sim->first_free_slot    = h->first_free_slot;
+    sim->next_pid           = h->next_pid;
+    sim->nspawned           = h->nspawned;
+    sim->nblocked           = h->nblocked;
+    sim->current_core       = h->current_core;
+    sim->nready             = h->nready;
+    sim->nwaiting_childless = h->nwaiting_childless;
+    sim->nsleeping          = h->nsleeping;
+    sim->finished           = h->finished;
+    sim->WAITING_queue      = h->WAITING_queue;
+    sim->USECS_SINCE_REBOOT = h->USECS_SINCE_REBOOT;
+    sim->total_time_on_CPU  = h->total_time_on_CPU;
+    sim->nevents            = h->nevents;
+    sim->nenqueued          = h->nenqueued;
+    sim->nsleeps            = h->nsleeps;
+    sim->nwaits             = h->nwaits;
+    sim->narrived           = h->narrived;
+    sim->ncoalesced         = h->ncoalesced;
+}
+
+//  FILL THE TABLES OF A NEW SIMULATION, FROM ANOTHER (WHEN FORKING) OR FROM A
+//  FILE, RETURNING THE CHECKSUM OF THEIR CONTENTS BEFORE THEY'RE ADJUSTED
+unsigned long long fill_state_tables(struct simulation *to, struct simulation *from, FILE *in)
+{
+    unsigned long long  hash    = HASH_SEED;
+    struct state_table  dst, src;
+
+    for(int t=0 ; state_table(to, t, &dst) ; ++t) {
+        int     capacity    = 0;
+
+        if(dst.n < 0) {
+            fail(&to->failure, "ERROR - the snapshot is corrupt");
+        }
+        *dst.table  = (dst.n > 0) ? grow_table(&to->failure, NULL, &capacity, dst.n, dst.size) : NULL;
+        if(dst.capacity != NULL) {
+            *dst.capacity   = capacity;
+        }
+        if(dst.n == 0) {
+            continue;
+        }
+        if(from != NULL) {
+            state_table(from, t, &src);
+            memcpy(*dst.table, *src.table, dst.n * dst.size);
+        }
+        else if(fread(*dst.table, dst.size, dst.n, in) != (size_t)dst.n) {
+            fail(&to->failure, "ERROR - the snapshot is truncated");
+        }
+        hash    = hash_bytes(hash, *dst.table, dst.n * dst.size);
+
+//  THE (COPIED) BUSES AND CORES DO NOT YET HAVE THEIR OWN TABLES
+        if(dst.table == (void **)&to->buses) {
+            FOREACH_BUS(to) {
+                to->buses[b].pending            = NULL;
+                to->buses[b].pending_capacity   = 0;
+            }
+        }
+        else if(dst.table == (void **)&to->cores) {
+            FOREACH_CORE(to) {
+                to->cores[k].READY_heap             = NULL;
+                to->cores[k].READY_heap_capacity    = 0;
+            }
+        }
+    }
+    return hash;
+}
+
+//  THE CONTINUATION MAY BE TRACED, FROM WHERE ITS SNAPSHOT WAS TAKEN
+void continue_from_snapshot(struct simulation *sim)
+{
+    sim->started    = true;
+    if(sim->trace != NULL && !sim->finished) {
+        open_tracer(sim, sim->trace, sim->trace_format);
+    }
+}
+
+void save_snapshot(struct simulation *sim, FILE *out)
+{
+    if(!sim->started || sim->failed) {
+        fail(&sim->failure, "ERROR - only a started simulation may be saved");
+    }
+    if(sim->arrivals != NULL) {
+        fail(&sim->failure, "ERROR - an open system cannot be saved");
+    }
+
+    struct snapshot_header  h;
+    struct state_table      st;
+
+    get_snapshot_header(sim, &h);
+    fwrite(&h, sizeof h, 1, out);
+    for(int t=0 ; state_table(sim, t, &st) ; ++t) {
+        if(st.n > 0) {
+            fwrite(*st.table, st.size, st.n, out);
+        }
+    }
+    if(ferror(out)) {
+        fail(&sim->failure, "ERROR - cannot write snapshot");
+    }
+}
+
+void restore_snapshot(struct simulation *sim, FILE *in)
+{
+    struct snapshot_header  h;
+
+    if(fread(&h, sizeof h, 1, in) != 1 || memcmp(h.magic, SNAPSHOT_MAGIC, sizeof h.magic) != 0 ||
+       h.version != SNAPSHOT_VERSION || h.layout != SNAPSHOT_LAYOUT) {
+        fail(&sim->failure, "ERROR - not a compatible snapshot");
+    }
+    if(sim->arrivals != NULL) {
+        fail(&sim->failure, "ERROR - an open system cannot be restored");
+    }
+    set_from_snapshot_header(sim, &h);
+    if(fill_state_tables(sim, NULL, in) != h.checksum) {
+        fail(&sim->failure, "ERROR - the snapshot is corrupt");
+    }
+    continue_from_snapshot(sim);
+}
+
+void fork_simulation(struct simulation *child, struct simulation *parent)
+{
+    struct snapshot_header  h;
+
+    get_snapshot_header(parent, &h);
+    set_from_snapshot_header(child, &h);
+    fill_state_tables(child, parent, NULL);
+    continue_from_snapshot(child);
+}
+
+//  ----------------------------------------------------------------------
+
+//  A PROFILED SIMULATION ALSO MEASURES THE REAL-WORLD TIME WITHIN EACH
+//  ms_step() (TO CONVERT ITS TICKS TO usecs) AND, ON LINUX, OPENS ITS HARDWARE
+//  COUNTERS ON ITS FIRST ms_step(), COUNTING ONLY THE THREAD EXECUTING IT,
+//  IN USER MODE.  THE KERNEL MAY FORBID THEM (see perf_event_paranoid).
+
+long long nsecs_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec*1000000000LL + now.tv_nsec;
+}
+
+#ifdef MYSCHEDULER_PROFILE
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+unsigned long long hw_counter_configs[NHW_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+};
+
+void open_hw_counters(struct profile *prof)
+{
+    for(int h=0 ; h<NHW_COUNTERS ; ++h) {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof attr);
+        attr.size           = sizeof attr;
+        attr.type           = PERF_TYPE_HARDWARE;
+        attr.config         = hw_counter_configs[h];
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        prof->hw_fd[h]      = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if(prof->hw_fd[h] < 0) {
+            prof->hw_fd[h]  = UNKNOWN;
+        }
+    }
+}
+
+void enable_hw_counters(struct profile *prof, bool enable)
+{
+    for(int h=0 ; h<NHW_COUNTERS ; ++h) {
+        if(prof->hw_fd[h] != UNKNOWN) {
+            ioctl(prof->hw_fd[h], enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+}
+
+//  THE COUNT, OR -1 IF THE COUNTER IS UNAVAILABLE
+long long read_hw_counter(const struct profile *prof, int h)
+{
+    long long count;
+
+    if(prof->hw_fd[h] == UNKNOWN || read(prof->hw_fd[h], &count, sizeof count) != sizeof count) {
+        return -1;
+    }
+    return count;
+}
+
+#else
+void open_hw_counters(struct profile *prof)
+{
+    for(int h=0 ; h<NHW_COUNTERS ; ++h) {
+        prof->hw_fd[h]  = UNKNOWN;
+    }
+}
+
+void enable_hw_counters(struct profile *prof, bool enable)
+{
+}
+
+long long read_hw_counter(const struct profile *prof, int h)
+{
+    return -1;
+}
+#endif
+
+void profile_step(struct profile *prof, bool starting)
+{
+    if(starting) {
+        if(!prof->hw_opened) {
+            open_hw_counters(prof);
+            prof->hw_opened = true;
+        }
+        prof->step_began    = nsecs_now();
+        enable_hw_counters(prof, true);
+    }
+    else {
+        enable_hw_counters(prof, false);
+        prof->step_nsecs    += nsecs_now() - prof->step_began;
+    }
+}
+
+void close_profile(struct profile *prof)
+{
+    for(int h=0 ; prof->hw_opened && h<NHW_COUNTERS ; ++h) {
+        if(prof->hw_fd[h] != UNKNOWN) {
+            close(prof->hw_fd[h]);
+        }
+    }
+}
+
+//  ONE LINE PER PHASE, THEN ONE OF THE HARDWARE COUNTERS
+void write_profile(const struct simulation *sim, FILE *fp)
+{
+    const struct phase  *step   = &sim->profile.phases[PHASE_STEP];
+    double  usecs_per_tick      = (step->ticks > 0) ? sim->profile.step_nsecs / 1000.0 / step->ticks : 0.0;
+
+    fprintf(fp, "%-12s %12s %14s %16s %12s %6s %10s\n",
+                "phase", "calls", "elements", "ticks", "usecs", "%step", "ticks/call");
+    for(int ph=0 ; ph<NPHASES ; ++ph) {
+        const struct phase  *phase  = (ph == PHASE_PARSE) ? &sim->w->profile.phases[ph]
+                                                          : &sim->profile.phases[ph];
+
+        fprintf(fp, "%-12s %12lli %14lli %16llu %12.0f %6.1f %10.0f\n", phase_names[ph],
+                    phase->ncalls, phase->nelements, phase->ticks, phase->ticks * usecs_per_tick,
+                    (step->ticks > 0) ? 100.0 * phase->ticks / step->ticks : 0.0,
+                    (phase->ncalls > 0) ? (double)phase->ticks / phase->ncalls : 0.0);
+    }
+
+    fprintf(fp, "hardware");
+    for(int h=0 ; h<NHW_COUNTERS ; ++h) {
+        long long   count   = sim->profile.hw_opened ? read_hw_counter(&sim->profile, h) : -1;
+
+        if(count < 0) {
+            fprintf(fp, "  %s unavailable", hw_counter_names[h]);
+        }
+        else {
+            fprintf(fp, "  %s %lli", hw_counter_names[h], count);
+        }
+    }
+    fprintf(fp, "\n");
+}
+
+#else
+#define profile_step(prof, starting)
+#define close_profile(prof)
+#endif
+
+//  ----------------------------------------------------------------------
+
+//  A LONG SIMULATION MAY PUBLISH ITS PROGRESS, EVERY interval MILLISECONDS
+//  OF REAL TIME, IN PROMETHEUS' TEXT FORMAT.  EVERY TELEMETRY_EVENTS EVENTS
+//  THE SIMULATION READS THE CLOCK AND, WHEN A SAMPLE IS DUE, COPIES ITS
+//  COUNTS INTO IT - UNLESS THE PUBLISHER HOLDS THE SAMPLE, WHEN IT TRIES
+//  AGAIN LATER, SO THE SIMULATION NEVER WAITS.  A BACKGROUND THREAD FORMATS
+//  EACH NEW SAMPLE, AND EITHER REPLACES A FILE (BY RENAMING A NEW ONE OVER
+//  IT) OR SERVES THE LATEST TO EACH CLIENT OF A UNIX-DOMAIN SOCKET, AS AN
+//  HTTP RESPONSE IF THE CLIENT SENDS A GET REQUEST.
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>                   // for struct timeval
+#include <sys/un.h>
+
+#define DEFAULT_TELEMETRY_MSECS 1000    // between samples
+#define TELEMETRY_EVENTS        4096    // between reading the clock, a power of 2
+#define TELEMETRY_POLL_MSECS    50      // the longest that the publisher sleeps
+#define TELEMETRY_REQUEST_MSECS 100     // for a client to send any request
+
+struct telemetry_sample {
+    long long   nsample;                // 0 before the first
+    long long   nsecs;                  // of real time, since publishing began
+    bool        finished;
+    usecs_t     usecs;
+    long long   nevents;
+    usecs_t     time_on_CPU;            // by all exited processes
+    int         nprocesses;
+    long long   nspawned;
+    int         nready, nsleeping, nwaiting;
+    int         *nblocked;              // per device
+    int         *bus_device;            // per bus, or UNKNOWN
+    usecs_t     *bus_usecs;             // per bus, transferring so far
+};
+
+struct telemetry {
+    const struct workload   *w;
+    int         ncores, nbuses;
+    char        *path;
+    char        *temporary;             // renamed to path, or NULL for a socket
+    int         listener;               // the socket, or UNKNOWN
+    long long   began, interval;        // in nsecs
+    long long   next_sample;
+
+    bool        stopping;
+    pthread_mutex_t lock;               // of sample and stopping
+    struct telemetry_sample sample;
+    pthread_t   publisher;
+    bool        publisher_started;
+
+//  ONLY THE PUBLISHER USES THESE
+    struct telemetry_sample latest, previous;
+    char        *text;                  // the latest sample, formatted
+    size_t      text_size;
+};
+
+bool alloc_sample(struct telemetry_sample *s, int ndevices, int nbuses)
+{
+    s->nblocked     = calloc(ndevices+1, sizeof s->nblocked[0]);
+    s->bus_device   = calloc(nbuses, sizeof s->bus_device[0]);
+    s->bus_usecs    = calloc(nbuses, sizeof s->bus_usecs[0]);
+    return s->nblocked != NULL && s->bus_device != NULL && s->bus_usecs != NULL;
+}
+
+void free_sample(struct telemetry_sample *s)
+{
+    free(s->nblocked);
+    free(s->bus_device);
+    free(s->bus_usecs);
+}
+
+void copy_sample(struct telemetry_sample *to, const struct telemetry_sample *from,
+                 int ndevices, int nbuses)
+{
+    int         *nblocked   = to->nblocked;
+    int         *bus_device = to->bus_device;
+    usecs_t     *bus_usecs  = to->bus_usecs;
+
+    *to             = *from;
+    to->nblocked    = memcpy(nblocked, from->nblocked, ndevices * sizeof nblocked[0]);
+    to->bus_device  = memcpy(bus_device, from->bus_device, nbuses * sizeof bus_device[0]);
+    to->bus_usecs   = memcpy(bus_usecs, from->bus_usecs, nbuses * sizeof bus_usecs[0]);
+}
+
+//  A LABEL'S VALUE, WITH ITS BACKSLASHES, QUOTES, AND NEWLINES ESCAPED
+void prometheus_label(FILE *fp, const char name[], const char value[])
+{
+    fprintf(fp, "%s=\"", name);
+    for( ; *value != '\0' ; ++value) {
+        if(*value == '\\' || *value == '"') {
+            fprintf(fp, "\\%c", *value);
+        }
+        else if(*value == '\n') {
+            fprintf(fp, "\\n");
+        }
+        else {
+            fputc(*value, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+void prometheus_metric(FILE *fp, const char name[], const char type[], const char help[])
+{
+    fprintf(fp, "# HELP myscheduler_%s %s\n", name, help);
+    fprintf(fp, "# TYPE myscheduler_%s %s\n", name, type);
+}
+
+//  FORMAT THE LATEST SAMPLE, ITS RATES BEING THOSE SINCE THE PREVIOUS ONE
+void format_telemetry(struct telemetry *t)
+{
+    const struct workload           *w      = t->w;
+    const struct telemetry_sample   *s      = &t->latest;
+    const struct telemetry_sample   *prev   = &t->previous;
+    double  seconds     = (s->nsecs - prev->nsecs) / 1e9;
+    FILE    *fp;
+
+    free(t->text);
+    t->text     = NULL;
+    if((fp = open_memstream(&t->text, &t->text_size)) == NULL) {
+        t->text_size    = 0;
+        return;
+    }
+
+    prometheus_metric(fp, "simulated_usecs", "counter", "Simulated usecs since reboot.");
+    fprintf(fp, "myscheduler_simulated_usecs %lli\n", s->usecs);
+    prometheus_metric(fp, "events_total", "counter", "Events executed.");
+    fprintf(fp, "myscheduler_events_total %lli\n", s->nevents);
+    prometheus_metric(fp, "wall_seconds", "counter", "Real seconds since publishing began.");
+    fprintf(fp, "myscheduler_wall_seconds %.3f\n", s->nsecs / 1e9);
+    prometheus_metric(fp, "simulated_usecs_per_second", "gauge",
+            "Simulated usecs per real second, since the previous sample.");
+    fprintf(fp, "myscheduler_simulated_usecs_per_second %.0f\n",
+            (seconds > 0) ? (s->usecs - prev->usecs) / seconds : 0.0);
+    prometheus_metric(fp, "events_per_second", "gauge", "Events per real second, since the previous sample.");
+    fprintf(fp, "myscheduler_events_per_second %.0f\n",
+            (seconds > 0) ? (s->nevents - prev->nevents) / seconds : 0.0);
+    prometheus_metric(fp, "finished", "gauge", "Whether all processes have exited.");
+    fprintf(fp, "myscheduler_finished %i\n", s->finished);
+
+    prometheus_metric(fp, "processes", "gauge", "Processes running.");
+    fprintf(fp, "myscheduler_processes %i\n", s->nprocesses);
+    prometheus_metric(fp, "processes_spawned_total", "counter", "Processes ever spawned.");
+    fprintf(fp, "myscheduler_processes_spawned_total %lli\n", s->nspawned);
+    prometheus_metric(fp, "queued_processes", "gauge", "Processes in each queue.");
+    fprintf(fp, "myscheduler_queued_processes{queue=\"ready\"} %i\n", s->nready);
+    fprintf(fp, "myscheduler_queued_processes{queue=\"sleeping\"} %i\n", s->nsleeping);
+    fprintf(fp, "myscheduler_queued_processes{queue=\"waiting\"} %i\n", s->nwaiting);
+    prometheus_metric(fp, "blocked_processes", "gauge", "Processes blocked on each device, including any transferring.");
+    FOREACH_DEVICE(w) {
+        fprintf(fp, "myscheduler_blocked_processes{");
+        prometheus_label(fp, "device", DEVICE_NAME(w, d));
+        fprintf(fp, "} %i\n", s->nblocked[d]);
+    }
+
+    prometheus_metric(fp, "bus_owner", "gauge", "The device transferring over each databus, if any.");
+    for(int b=0 ; b<t->nbuses ; ++b) {
+        fprintf(fp, "myscheduler_bus_owner{bus=\"%i\",", b);
+        prometheus_label(fp, "device", (s->bus_device[b] == UNKNOWN) ? "" : DEVICE_NAME(w, s->bus_device[b]));
+        fprintf(fp, "} %i\n", s->bus_device[b] != UNKNOWN);
+    }
+    prometheus_metric(fp, "bus_utilization_ratio", "gauge", "The fraction of simulated time that each databus has transferred.");
+    for(int b=0 ; b<t->nbuses ; ++b) {
+        fprintf(fp, "myscheduler_bus_utilization_ratio{bus=\"%i\"} %.4f\n", b,
+                (s->usecs > 0) ? (double)s->bus_usecs[b] / s->usecs : 0.0);
+    }
+    prometheus_metric(fp, "cpu_utilization_ratio", "gauge", "The usecs onCPU of all exited processes, over those of all cores.");
+    fprintf(fp, "myscheduler_cpu_utilization_ratio %.4f\n",
+            (s->usecs > 0) ? (double)s->time_on_CPU / ((double)t->ncores * s->usecs) : 0.0);
+
+    if(fclose(fp) != 0) {
+        free(t->text);
+        t->text         = NULL;
+        t->text_size    = 0;
+    }
+}
+
+//  WRITE ALL OF A BUFFER, UNLESS THE CLIENT HAS GONE
+void send_all(int fd, const char *buf, size_t size)
+{
+    while(size > 0) {
+        ssize_t n   = send(fd, buf, size, MSG_NOSIGNAL);
+
+        if(n <= 0) {
+            break;
+        }
+        buf    += n;
+        size   -= n;
+    }
+}
+
+void serve_telemetry_client(struct telemetry *t)
+{
+    int     client  = accept(t->listener, NULL, NULL);
+
+    if(client < 0) {
+        return;
+    }
+
+//  A CLIENT THAT DOES NOT READ ITS RESPONSE CANNOT DELAY OTHERS FOR LONG
+    struct timeval  timeout = { 1, 0 };
+    struct pollfd   pfd     = { client, POLLIN, 0 };
+    char            request[BUFSIZ];
+    ssize_t         n       = 0;
+
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+    if(poll(&pfd, 1, TELEMETRY_REQUEST_MSECS) > 0) {
+        n   = recv(client, request, sizeof request, 0);
+    }
+    if(n >= 4 && memcmp(request, "GET ", 4) == 0) {
+        char    header[BUFSIZ];
+        int     length  = snprintf(header, sizeof header,
+                                "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                "Content-Length: %zu\r\n\r\n", t->text_size);
+
+        send_all(client, header, length);
+    }
+    send_all(client, t->text, t->text_size);
+    close(client);
+}
+
+//  A NEW FILE IS RENAMED OVER THE OLD, SO READERS NEVER SEE A PARTIAL ONE
+void write_telemetry_file(struct telemetry *t)
+{
+    FILE    *fp = fopen(t->temporary, "w");
+
+    if(fp != NULL) {
+        bool    written = fwrite(t->text, 1, t->text_size, fp) == t->text_size;
+
+        if(fclose(fp) == 0 && written) {
+            rename(t->temporary, t->path);
+        }
+    }
+}
+
+void *telemetry_publisher(void *arg)
+{
+    struct telemetry    *t  = arg;
+    bool                stopping;
+
+    do {
+        if(t->listener != UNKNOWN) {
+            struct pollfd   pfd = { t->listener, POLLIN, 0 };
+
+            if(poll(&pfd, 1, TELEMETRY_POLL_MSECS) > 0 && t->text != NULL) {
+                serve_telemetry_client(t);
+            }
+        }
+        else {
+            poll(NULL, 0, TELEMETRY_POLL_MSECS);
+        }
+
+        pthread_mutex_lock(&t->lock);
+        stopping    = t->stopping;
+        bool fresh  = t->sample.nsample != t->latest.nsample;
+
+        if(fresh) {
+            copy_sample(&t->previous, &t->latest, t->w->ndevices, t->nbuses);
+            copy_sample(&t->latest, &t->sample, t->w->ndevices, t->nbuses);
+        }
+        pthread_mutex_unlock(&t->lock);
+
+        if(fresh) {
+            format_telemetry(t);
+            if(t->temporary != NULL && t->text != NULL) {
+                write_telemetry_file(t);
+            }
+        }
+    } while(!stopping);
+    return NULL;
+}
+
+//  SAMPLE THE SIMULATION, IF DUE, UNLESS THE PUBLISHER HOLDS THE SAMPLE.
+//  THE FINAL SAMPLE, ONCE FINISHED, IS ALWAYS TAKEN.
+void sample_telemetry(struct simulation *sim)
+{
+    struct telemetry        *t  = sim->telemetry;
+    struct telemetry_sample *s  = &t->sample;
+    long long               now = nsecs_now();
+
+    if(sim->finished) {
+        if(s->finished) {
+            return;
+        }
+        pthread_mutex_lock(&t->lock);
+    }
+    else if(now < t->next_sample || pthread_mutex_trylock(&t->lock) != 0) {
+        return;
+    }
+    ++s->nsample;
+    s->nsecs        = now - t->began;
+    s->finished     = sim->finished;
+    s->usecs        = sim->USECS_SINCE_REBOOT;
+    s->nevents      = sim->nevents;
+    s->time_on_CPU  = sim->total_time_on_CPU;
+    s->nprocesses   = sim->nprocesses;
+    s->nspawned     = sim->nspawned;
+    s->nready       = sim->nready;
+    s->nsleeping    = sim->nsleeping;
+    s->nwaiting     = sim->WAITING_queue.n;
+
+    FOREACH_DEVICE(sim->w) {
+        s->nblocked[d]  = (sim->IO_BLOCKED_queues != NULL) ? sim->IO_BLOCKED_queues[d].n : 0;
+    }
+
+//  A BUS'S CURRENT TRANSFER WAS ADDED TO ITS DEVICE'S TOTAL IN FULL WHEN IT
+//  STARTED, SO EACH BUS BEGINS WITH THE NEGATIVE OF ITS IN-FLIGHT TRANSFER'S
+//  REMAINDER, SUBTRACTING THE usecs THAT HAVE NOT YET ELAPSED
+    FOREACH_BUS(sim) {
+        s->bus_device[b]    = (sim->buses != NULL) ? sim->buses[b].device : UNKNOWN;
+        s->bus_usecs[b]     = 0;
+        if(s->bus_device[b] != UNKNOWN && sim->buses[b].inuse_until > sim->USECS_SINCE_REBOOT) {
+            s->bus_usecs[b] = sim->USECS_SINCE_REBOOT - sim->buses[b].inuse_until;
+        }
+    }
+    if(sim->device_metrics != NULL) {
+        FOREACH_DEVICE(sim->w) {
+            s->bus_usecs[sim->w->devices[d].bus]   +=
+                    sim->device_metrics[d*MS_NDEVICE_METRICS + MS_DEVICE_TRANSFER].total;
+        }
+    }
+    pthread_mutex_unlock(&t->lock);
+    t->next_sample  = now + t->interval;
+}
+
+void open_telemetry(struct simulation *sim, const char path[], bool socket_path, int interval_msecs)
+{
+    struct telemetry    *t  = calloc(1, sizeof *t);
+
+    if(t == NULL) {
+        fail(&sim->failure, "ERROR - out of memory for telemetry");
+    }
+    t->listener     = UNKNOWN;
+    sim->telemetry  = t;
+    if((t->path = strdup(path)) == NULL ||
+       !alloc_sample(&t->sample, sim->w->ndevices, sim->nbuses) ||
+       !alloc_sample(&t->latest, sim->w->ndevices, sim->nbuses) ||
+       !alloc_sample(&t->previous, sim->w->ndevices, sim->nbuses)) {
+        fail(&sim->failure, "ERROR - out of memory for telemetry");
+    }
+    t->w            = sim->w;
+    t->ncores       = sim->ncores;
+    t->nbuses       = sim->nbuses;
+    t->interval     = (interval_msecs > 0) ? interval_msecs * 1000000LL : 1;
+    t->began        = nsecs_now();
+
+    if(socket_path) {
+        struct sockaddr_un  addr    = { .sun_family = AF_UNIX };
+        struct stat         st;
+
+        if(strlen(path) >= sizeof addr.sun_path) {
+            fail(&sim->failure, "ERROR - socket name '%s' is too long", path);
+        }
+        strcpy(addr.sun_path, path);
+
+//  A SOCKET LEFT BY AN EARLIER RUN IS REPLACED, BUT NO OTHER KIND OF FILE
+        if(stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(path);
+        }
+        if((t->listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+           bind(t->listener, (struct sockaddr *)&addr, sizeof addr) != 0 ||
+           listen(t->listener, SOMAXCONN) != 0) {
+            if(t->listener >= 0) {
+                close(t->listener);
+            }
+            t->listener = UNKNOWN;
+            fail(&sim->failure, "ERROR - cannot listen on socket '%s'", path);
+        }
+    }
+    else {
+        if((t->temporary = malloc(strlen(path) + sizeof ".tmp")) == NULL) {
+            fail(&sim->failure, "ERROR - out of memory for telemetry");
+        }
+        sprintf(t->temporary, "%s.tmp", path);
+
+        FILE    *fp = fopen(t->temporary, "w");
+
+        if(fp == NULL) {
+            fail(&sim->failure, "ERROR - cannot create '%s'", t->temporary);
+        }
+        fclose(fp);
+        remove(t->temporary);
+    }
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_create(&t->publisher, NULL, telemetry_publisher, t);
+    t->publisher_started = true;
+}
+
+//  PUBLISH THE LAST SAMPLE, AND WAIT FOR THE PUBLISHER TO FINISH
+void close_telemetry(struct simulation *sim)
+{
+    struct telemetry    *t  = sim->telemetry;
+
+    if(t != NULL) {
+        if(t->publisher_started) {
+            pthread_mutex_lock(&t->lock);
+            t->stopping = true;
+            pthread_mutex_unlock(&t->lock);
+            pthread_join(t->publisher, NULL);
+            pthread_mutex_destroy(&t->lock);
+        }
+        if(t->listener != UNKNOWN) {
+            close(t->listener);
+            unlink(t->path);
+        }
+        free_sample(&t->sample);
+        free_sample(&t->latest);
+        free_sample(&t->previous);
+        free(t->text);
+        free(t->temporary);
+        free(t->path);
+        free(t);
+        sim->telemetry  = NULL;
+    }
+}
+
+//  ----------------------------------------------------------------------
+
+//  A WORKLOAD MAY BE ANALYZED WITHOUT EXECUTING IT.  EACH COMMAND IS CHECKED
+//  FOR SYSCALLS THAT CANNOT EXECUTE AS WRITTEN, AND THE GRAPH OF SPAWNS IS
+//  WALKED DEPTH-FIRST (EACH COMMAND ONCE) TO FIND COMMANDS THAT SPAWN
+//  THEMSELVES, WAITS THAT CAN NEVER BE SATISFIED, AND COMMANDS THAT NEVER EXIT.
+//
+//  THE DEMANDS OF THE PROCESSES SPAWNED FROM THE FIRST COMMAND ARE SUMMED
+//  OVER ITS TREE OF SPAWNS, BOUNDING THE MAKESPAN OF A CLOSED SYSTEM.  IT IS
+//  AT LEAST THE LONGEST OF: ALL usecs ONCPU, WITH A CONTEXT SWITCH FOR EACH
+//  SYSCALL, SHARED AMONG ALL CORES; THE usecs OF THE BUSIEST DATABUS; AND
+//  THE LONGEST CHAIN OF COMPUTING, SLEEPING, TRANSFERRING, AND WAITING FROM
+//  THE FIRST PROCESS TO ANY OF ITS DESCENDANTS.  IT IS AT MOST THE SUM OF
+//  EVERYTHING, AS IF NOTHING OVERLAPPED: ALL usecs ONCPU, SLEEPING, AND
+//  TRANSFERRING, AND EVERY TRANSITION, CONTEXT SWITCH, AND STEAL (INCLUDING
+//  THOSE OF EVERY TIMEQUANTUM THAT COULD EXPIRE).
+//  EACH DRAWN VALUE IS TAKEN TO BE ITS DISTRIBUTION'S MEAN, SO THE BOUNDS OF
+//  A STOCHASTIC WORKLOAD ARE ONLY APPROXIMATE.
+
+#define ANALYZE_UNVISITED               0
+#define ANALYZE_VISITING                1       // on the current path of spawns
+#define ANALYZE_VISITED                 2
+
+//  THE DEMANDS OF A COMMAND'S PROCESS, WITH THOSE OF ALL ITS DESCENDANTS
+struct command_analysis {
+    int         state;                  // ANALYZE_UNVISITED ...
+    bool        exits;                  // does it exit?
+    bool        finishes;               // do it and all its descendants exit?
+    double      nprocesses;             // itself and all its descendants
+    double      time_on_CPU;
+    double      nsyscalls;              // each needs a dispatch, including exit
+    double      sleeping;               // usecs, with the tick of each sleep
+    double      path;                   // from its spawn until all have exited
+};
+
+//  A COMMAND ON THE CURRENT PATH OF SPAWNS, PART-WAY THROUGH ITS SYSCALLS.
+//  THE PATH IS KEPT ON AN EXPLICIT STACK, AS IT MAY BE AS DEEP AS THERE ARE
+//  COMMANDS, FAR DEEPER THAN THE C STACK COULD RECURSE.
+struct analysis_frame {
+    int         command;
+    int         s;                      // its next syscall
+    bool        spawning;               // syscall s's command has just been analyzed
+    bool        exits;
+    bool        blocked;                // waiting forever
+    bool        children_finish;
+    int         unfinished;             // a child spawned since the last wait, never exiting
+    double      cpu;
+    double      t;
+    double      children_done;          // since the last wait
+    double      all_done;
+};
+
+struct analyzer {
+    struct workload *w;
+    FILE        *report;                // of problems, or NULL
+    int         nproblems;
+    bool        approximate;            // a value was drawn from a distribution
+    bool        coalescing;
+    bool        misconfigured;          // no simulation can start
+    int         nbuses;
+
+    struct command_analysis *commands;
+    int         commands_capacity;
+    double      *bus_usecs;             // [ncommands][nbuses] transferring
+    double      *bus_ntransfers;        // [ncommands][nbuses]
+    int         bus_capacity;
+    struct analysis_frame   *stack;     // the current path of spawns
+    int         stack_capacity;
+};
+
+void analysis_problem(struct analyzer *a, const char severity[], char *fmt, ...)
+{
+    va_list ap;
+
+    ++a->nproblems;
+    if(a->report != NULL) {
+        va_start(ap, fmt);
+        fprintf(a->report, "%s - ", severity);
+        vfprintf(a->report, fmt, ap);
+        fprintf(a->report, "\n");
+        va_end(ap);
+    }
+}
+
+//  A SYSCALL'S FIXED VALUE, OR THE MEAN OF ITS DISTRIBUTION
+double analysis_value(struct analyzer *a, long long value, int distribution)
+{
+    if(distribution == UNKNOWN) {
+        return value;
+    }
+    a->approximate  = true;
+    return distribution_mean(a->w, distribution);
+}
+
+//  A FIXED TIME BEFORE AN EARLIER ONE IS ISSUED AT ONCE, NOT WHEN WRITTEN,
+//  AND NOTHING AFTER AN exit IS EVER EXECUTED
+void check_syscalls(struct analyzer *a, int c)
+{
+    struct workload *w  = a->w;
+    usecs_t latest      = 0;
+
+    for(int s=0 ; s<w->commands[c].nsyscalls ; ++s) {
+        struct syscall *sc  = COMMAND_SYSCALL(w, c, s);
+
+        if(sc->when_distribution == UNKNOWN) {
+            if(sc->when < latest) {
+                analysis_problem(a, "WARNING", "command '%s' issues syscall %i '%s' at %lliusecs, before %lliusecs",
+                        COMMAND_NAME(w, c), s+1, syscalls[sc->which], sc->when, latest);
+            }
+            else {
+                latest  = sc->when;
+            }
+        }
+        if(sc->which == SYS_EXIT && s < w->commands[c].nsyscalls-1) {
+            analysis_problem(a, "WARNING", "command '%s' never executes its %i syscall%s after 'exit'",
+                    COMMAND_NAME(w, c), w->commands[c].nsyscalls-1-s,
+                    (s == w->commands[c].nsyscalls-2) ? "" : "s");
+            break;
+        }
+    }
+}
+
+//  BEGIN TO ANALYZE A COMMAND, AS THE NEXT FRAME OF THE STACK
+void push_analysis(struct analyzer *a, int depth, int c)
+{
+    a->stack    = grow_table(&a->w->failure, a->stack, &a->stack_capacity,
+                                depth+1, sizeof a->stack[0]);
+
+    struct analysis_frame   *f  = &a->stack[depth];
+
+    memset(f, 0, sizeof *f);
+    f->command          = c;
+    f->children_finish  = true;
+    f->unfinished       = UNKNOWN;
+    f->t                = TIME_CONTEXT_SWITCH + 1;
+    a->commands[c].state        = ANALYZE_VISITING;
+    a->commands[c].nprocesses   = 1;
+}
+
+//  ANALYZE A COMMAND, HAVING FIRST ANALYZED EACH COMMAND THAT IT SPAWNS.
+//  ITS path IS A LOWER BOUND, FROM ITS SPAWN, ON EACH STEP: A DISPATCH (A
+//  CONTEXT SWITCH, AND THE TICK BEFORE COMPUTING), ITS COMPUTING, AND THE
+//  TRANSITIONS, SLEEP, TRANSFER, OR WAIT FOR CHILDREN BEFORE ITS NEXT DISPATCH.
+//  AN UNVISITED COMMAND THAT IT SPAWNS IS PUSHED ONTO THE STACK, AND THE
+//  SPAWN RESUMES ONCE THAT COMMAND HAS BEEN ANALYZED AND POPPED.
+void analyze_command(struct analyzer *a, int root)
+{
+    struct workload         *w      = a->w;
+    double  dispatch        = TIME_CONTEXT_SWITCH + 1;
+    int     depth           = 0;
+
+    push_analysis(a, depth++, root);
+    while(depth > 0) {
+        struct analysis_frame   *f  = &a->stack[depth-1];
+        int                     c   = f->command;
+        struct command_analysis *ca = &a->commands[c];
+        double  *bus_usecs      = &a->bus_usecs[c * a->nbuses];
+        double  *bus_ntransfers = &a->bus_ntransfers[c * a->nbuses];
+
+//  THE COMMAND HAS NO MORE SYSCALLS TO ANALYZE
+        if(f->s == w->commands[c].nsyscalls || f->exits || f->blocked) {
+            if(!f->exits && !f->blocked) {
+                analysis_problem(a, "ERROR", "command '%s' never calls 'exit', so never finishes", COMMAND_NAME(w, c));
+            }
+            if(f->children_done > f->all_done) {
+                f->all_done = f->children_done;
+            }
+            ca->time_on_CPU    += f->cpu;
+            ca->path            = (f->t > f->all_done) ? f->t : f->all_done;
+            ca->exits           = f->exits;
+            ca->finishes        = f->exits && f->children_finish;
+            ca->state           = ANALYZE_VISITED;
+            --depth;
+            continue;
+        }
+
+        struct syscall *sc  = COMMAND_SYSCALL(w, c, f->s);
+
+        if(!f->spawning) {
+            double  computing;
+
+            if(sc->when_distribution != UNKNOWN) {
+                computing   = analysis_value(a, 0, sc->when_distribution);
+            }
+            else {
+                computing   = (sc->when > f->cpu) ? sc->when - f->cpu : 0.0;
+            }
+            f->cpu         += computing;
+            f->t           += computing;
+            ca->nsyscalls  += 1;
+
+            if(sc->which == SYS_SPAWN && a->commands[sc->operand].state == ANALYZE_UNVISITED) {
+                f->spawning = true;
+                push_analysis(a, depth++, sc->operand);
+                continue;
+            }
+        }
+        f->spawning = false;
+
+        switch (sc->which) {
+            case SYS_SPAWN: {
+                int d                   = sc->operand;
+                struct command_analysis *da = &a->commands[d];
+
+                if(da->state == ANALYZE_VISITING) {
+                    if(d == c) {
+                        analysis_problem(a, "ERROR", "command '%s' spawns itself, exceeding %i processes",
+                                COMMAND_NAME(w, c), MAX_RUNNING_PROCESSES);
+                    }
+                    else {
+                        analysis_problem(a, "ERROR", "command '%s' spawns '%s', which spawned it, exceeding %i processes",
+                                COMMAND_NAME(w, c), COMMAND_NAME(w, d), MAX_RUNNING_PROCESSES);
+                    }
+                    f->children_finish  = false;
+                }
+                else {
+                    ca->nprocesses     += da->nprocesses;
+                    ca->time_on_CPU    += da->time_on_CPU;
+                    ca->nsyscalls      += da->nsyscalls;
+                    ca->sleeping       += da->sleeping;
+                    FOREACH_BUS(a) {
+                        bus_usecs[b]       += a->bus_usecs[d * a->nbuses + b];
+                        bus_ntransfers[b]  += a->bus_ntransfers[d * a->nbuses + b];
+                    }
+                    if(!da->finishes) {
+                        f->children_finish  = false;
+                    }
+                    if(!da->exits) {
+                        f->unfinished       = d;
+                    }
+                    if(f->t + da->path > f->children_done) {
+                        f->children_done    = f->t + da->path;
+                    }
+                }
+                f->t   += TIME_CORE_STATE_TRANSITIONS + dispatch;
+                break;
+            }
+            case SYS_READ:
+            case SYS_WRITE: {
+                double  nbytes  = analysis_value(a, sc->arg, sc->arg_distribution);
+                double  usecs   = ceil(1000000.0*nbytes / (double)device_speed(w, sc->operand, sc->which));
+                int     b       = w->devices[sc->operand].bus % a->nbuses;
+
+                bus_usecs[b]       += usecs;
+                bus_ntransfers[b]  += 1;
+                f->t   += TIME_CORE_STATE_TRANSITIONS + (a->coalescing ? 0 : TIME_ACQUIRE_BUS) + usecs +
+                            TIME_CORE_STATE_TRANSITIONS + dispatch;
+                break;
+            }
+            case SYS_SLEEP: {
+                double  usecs   = analysis_value(a, sc->arg, sc->arg_distribution);
+
+                ca->sleeping   += usecs + 1;
+                f->t   += usecs + TIME_CORE_STATE_TRANSITIONS + dispatch;
+                break;
+            }
+//  A WAIT FOR A CHILD THAT NEVER EXITS NEVER RETURNS, SO NOTHING AFTER IT EXECUTES
+            case SYS_WAIT:
+                if(f->unfinished != UNKNOWN) {
+                    analysis_problem(a, "ERROR", "command '%s' waits forever, as '%s' never exits",
+                            COMMAND_NAME(w, c), COMMAND_NAME(w, f->unfinished));
+                    f->blocked  = true;
+                    break;
+                }
+                if(f->children_done > f->all_done) {
+                    f->all_done = f->children_done;
+                }
+                f->t    = ((f->t > f->children_done) ? f->t : f->children_done) +
+                            TIME_CORE_STATE_TRANSITIONS + dispatch;
+                f->children_done    = 0.0;
+                break;
+
+            case SYS_EXIT:
+                f->exits    = true;
+                break;
+        }
+        ++f->s;
+    }
+}
+
+void analyze_workload(struct analyzer *a, const struct ms_config *config, struct ms_analysis *analysis)
+{
+    struct workload *w  = a->w;
+    int     ncores      = (config->ncores > 0) ? config->ncores : DEFAULT_CORES;
+    double  steal       = (config->steal_policy != STEAL_NONE) ? config->time_steal : 0;
+
+    a->nbuses           = (config->nbuses > 0) ? config->nbuses : DEFAULT_BUSES;
+    a->coalescing       = (config->coalesce_count > 0 || config->coalesce_bytes > 0);
+    memset(analysis, 0, sizeof *analysis);
+
+    FOREACH_DEVICE(w) {
+        if(w->devices[d].bus >= a->nbuses) {
+            analysis_problem(a, "ERROR", "device '%s' is on bus %i, but there are only %i buses",
+                    DEVICE_NAME(w, d), w->devices[d].bus, a->nbuses);
+            a->misconfigured    = true;
+        }
+    }
+    if(w->ncommands == 0) {
+        analysis->nproblems = a->nproblems;
+        analysis->finishes  = !a->misconfigured;
+        return;
+    }
+
+    int     ntables     = w->ncommands * a->nbuses;
+
+    a->commands         = grow_table(&w->failure, NULL, &a->commands_capacity,
+                                w->ncommands, sizeof a->commands[0]);
+    a->bus_usecs        = grow_table(&w->failure, NULL, &a->bus_capacity,
+                                ntables, sizeof a->bus_usecs[0]);
+    a->bus_capacity     = 0;
+    a->bus_ntransfers   = grow_table(&w->failure, NULL, &a->bus_capacity,
+                                ntables, sizeof a->bus_ntransfers[0]);
+    memset(a->commands, 0, w->ncommands * sizeof a->commands[0]);
+    memset(a->bus_usecs, 0, ntables * sizeof a->bus_usecs[0]);
+    memset(a->bus_ntransfers, 0, ntables * sizeof a->bus_ntransfers[0]);
+
+    FOREACH_COMMAND(w) {
+        check_syscalls(a, c);
+    }
+//  ANY COMMAND MAY BE SPAWNED BY AN ARRIVAL, SO ALL ARE ANALYZED
+    FOREACH_COMMAND(w) {
+        if(a->commands[c].state == ANALYZE_UNVISITED) {
+            analyze_command(a, c);
+        }
+    }
+    analysis->nproblems     = a->nproblems;
+    analysis->approximate   = a->approximate;
+
+//  THE BOUNDS ARE THOSE OF THE FIRST COMMAND'S PROCESS, AND ITS DESCENDANTS
+    struct command_analysis *root   = &a->commands[0];
+    double  bus_lo      = 0.0;
+    double  bus_hi      = 0.0;
+
+    FOREACH_BUS(a) {
+        double  usecs   = a->bus_usecs[b];
+        double  n       = a->bus_ntransfers[b];
+        double  lo      = usecs + (a->coalescing ? ((n > 0) ? TIME_ACQUIRE_BUS : 0) : n*TIME_ACQUIRE_BUS);
+
+        if(lo > bus_lo) {
+            bus_lo  = lo;
+        }
+        bus_hi     += usecs + n*TIME_ACQUIRE_BUS;
+    }
+
+//  EVERY SYSCALL (BUT exit) MAY COST A TICK, TWO TRANSITIONS (LEAVING THE
+//  CPU, THEN BECOMING READY AGAIN), AND A DISPATCH THAT STEALS.  EVERY
+//  TIMEQUANTUM HOLDS AT LEAST ITS timequantum'S usecs ONCPU
+    usecs_t quantum     = config->timequantum;
+
+    switch (config->scheduler) {
+        case SCHEDULER_CFS:
+            quantum    /= CFS_MIN_GRANULARITY;
+            break;
+
+        case SCHEDULER_SJF:
+            quantum     = NO_TIMEQUANTUM;
+            break;
+    }
+    double  dispatch    = 1 + TIME_CONTEXT_SWITCH + steal;
+    double  nexpiries   = root->time_on_CPU / ((quantum > 1) ? quantum : 1);
+    double  work_lo     = root->time_on_CPU + root->nsyscalls*(TIME_CONTEXT_SWITCH + 1);
+    double  work_hi     = root->time_on_CPU +
+                            root->nsyscalls*(1 + 2*TIME_CORE_STATE_TRANSITIONS + dispatch) +
+                            nexpiries*(TIME_CORE_STATE_TRANSITIONS + dispatch);
+
+    double  makespan_lo = ceil(work_lo / ncores);
+    double  makespan_hi = work_hi + root->sleeping + bus_hi;
+
+    if(bus_lo > makespan_lo) {
+        makespan_lo = bus_lo;
+    }
+    if(root->path > makespan_lo) {
+        makespan_lo = root->path;
+    }
+
+#define ANALYSIS_VALUE(x)   (((x) < (double)(LLONG_MAX/4)) ? (long long)(x) : LLONG_MAX/4)
+
+    analysis->finishes      = root->finishes && !a->misconfigured;
+    analysis->nprocesses    = ANALYSIS_VALUE(root->nprocesses);
+    analysis->time_on_CPU   = ANALYSIS_VALUE(root->time_on_CPU);
+    analysis->bus_usecs     = ANALYSIS_VALUE(bus_lo);
+    analysis->critical_path = ANALYSIS_VALUE(root->path);
+    analysis->makespan_lo   = ANALYSIS_VALUE(makespan_lo);
+    analysis->utilization_hi= (makespan_lo > 0) ?
+                                fmin(floor(100.0*root->time_on_CPU / (ncores*makespan_lo)), 100) : 0;
+    if(analysis->finishes) {
+        analysis->makespan_hi   = ANALYSIS_VALUE(makespan_hi);
+        analysis->utilization_lo= (makespan_hi > 0) ?
+                                floor(100.0*root->time_on_CPU / (ncores*makespan_hi)) : 0;
+    }
+    else {
+        analysis->makespan_hi   = -1;
+    }
+
+    if(root->nprocesses > MAX_RUNNING_PROCESSES) {
+        analysis_problem(a, "WARNING", "command '%s' spawns %.0f processes in all, which may exceed %i running",
+                COMMAND_NAME(w, 0), root->nprocesses, MAX_RUNNING_PROCESSES);
+        analysis->nproblems = a->nproblems;
+    }
+}
+
+//  ----------------------------------------------------------------------
+
+//  THE LIBRARY API, DESCRIBED IN myscheduler.h .
+//  EACH FUNCTION THAT MAY FAIL FIRST RECORDS WHERE TO RETURN TO, IF IT DOES.
+
+static int init_workload(struct workload *w)
+{
+    if(setjmp(w->failure.on_error) != 0) {
+        return -1;
+    }
+    init_symbols(w);
+    return 0;
+}
+
+struct workload *ms_new_workload(FILE *warnings)
+{
+    struct workload *w  = calloc(1, sizeof *w);
+
+    if(w == NULL) {
+        return NULL;
+    }
+    w->warnings             = warnings;
+    w->config.timequantum   = DEFAULT_TIME_QUANTUM;
+    w->config.ncores        = DEFAULT_CORES;
+    w->config.steal_policy  = STEAL_BUSIEST;
+    w->config.time_steal    = DEFAULT_TIME_STEAL;
+    w->config.scheduler     = SCHEDULER_RR;
+    w->config.nbuses        = DEFAULT_BUSES;
+    w->config.arbitration   = ARBITRATE_FASTEST;
+    w->config.seed          = DEFAULT_SEED;
+    w->config.trace         = NULL;
+
+    if(init_workload(w) != 0) {
+        ms_free_workload(w);
+        return NULL;
+    }
+    return w;
+}
+
+//  A FAILED WORKLOAD CANNOT BE LOADED ANY FURTHER
+static int workload_failed(struct workload *w)
+{
+    close_scanner(&w->in);
+    w->failed   = true;
+    return -1;
+}
+
+int ms_load_sysconfig(struct workload *w, const char filename[])
+{
+    if(w->failed) {
+        return -1;
+    }
+    if(setjmp(w->failure.on_error) != 0) {
+        return workload_failed(w);
+    }
+    PROFILE_BEGIN();
+    read_sysconfig(w, filename);
+    PROFILE_END(&w->profile, PHASE_PARSE);
+    return 0;
+}
+
+int ms_load_commands(struct workload *w, const char filename[])
+{
+    if(w->failed) {
+        return -1;
+    }
+    if(setjmp(w->failure.on_error) != 0) {
+        return workload_failed(w);
+    }
+    PROFILE_BEGIN();
+    read_commands(w, filename);
+    PROFILE_END(&w->profile, PHASE_PARSE);
+    return 0;
+}
+
+int ms_write_image(struct workload *w, const char filename[])
+{
+    if(w->failed) {
+        return -1;
+    }
+    if(setjmp(w->failure.on_error) != 0) {
+        return -1;
+    }
+    write_image(w, filename);
+    return 0;
+}
+
+void ms_default_config(const struct workload *w, struct ms_config *config)
+{
+    *config = w->config;
+}
+
+int ms_analyze(struct workload *w, const struct ms_config *config, FILE *report,
+               struct ms_analysis *analysis)
+{
+    struct analyzer a   = { .w = w, .report = report };
+
+    if(w->failed) {
+        return -1;
+    }
+    if(setjmp(w->failure.on_error) != 0) {
+        free(a.commands);
+        free(a.bus_usecs);
+        free(a.bus_ntransfers);
+        free(a.stack);
+        return -1;
+    }
+    analyze_workload(&a, (config != NULL) ? config : &w->config, analysis);
+    free(a.commands);
+    free(a.bus_usecs);
+    free(a.bus_ntransfers);
+    free(a.stack);
+    return 0;
+}
+
+const char *ms_workload_error(const struct workload *w)
+{
+    return w->failure.message;
+}
+
+void ms_free_workload(struct workload *w)
+{
+    if(w != NULL) {
+        if(w->image.map != NULL) {          // the tables are within the image
+            close_scanner(&w->image);
+        }
+        else {
+            free(w->symbols);
+            free(w->symbol_names);
+            free(w->symbol_hash);
+            free(w->commands);
+            free(w->all_syscalls);
+            free(w->distributions);
+            free(w->distribution_params);
+        }
+        free(w->devices);
+        free(w->source_name);
+        free(w);
+    }
+}
+
+struct simulation *ms_new_simulation(const struct workload *w, const struct ms_config *config)
+{
+    struct simulation *sim  = calloc(1, sizeof *sim);
+
+    if(sim == NULL) {
+        return NULL;
+    }
+    if(config == NULL) {
+        config  = &w->config;
+    }
+    sim->w              = w;
+    sim->timequantum    = config->timequantum;
+    sim->ncores         = (config->ncores > 0) ? config->ncores : DEFAULT_CORES;
+    sim->steal_policy   = config->steal_policy;
+    sim->time_steal     = config->time_steal;
+    sim->scheduler      = &schedulers[(config->scheduler >= 0 && config->scheduler <= SCHEDULER_PRIORITY) ?
+                                        config->scheduler : SCHEDULER_RR];
+    sim->nbuses         = (config->nbuses > 0) ? config->nbuses : DEFAULT_BUSES;
+    sim->arbitration    = (config->arbitration >= 0 && config->arbitration <= ARBITRATE_DEADLINE) ?
+                                config->arbitration : ARBITRATE_FASTEST;
+    sim->coalesce_count = (config->coalesce_count > 0) ? config->coalesce_count : 0;
+    sim->coalesce_bytes = (config->coalesce_bytes > 0) ? config->coalesce_bytes : 0;
+    sim->seed           = config->seed;
+    sim->trace          = config->trace;
+    sim->trace_format   = config->trace_format;
+    sim->next_arrival   = LLONG_MAX;
+    return sim;
+}
+
+long long ms_step(struct simulation *sim, long long nevents)
+{
+    if(sim->failed) {
+        return -1;
+    }
+    if(setjmp(sim->failure.on_error) != 0) {
+        sim->failed = true;
+        close_tracer(sim);
+        return -1;
+    }
+    if(!sim->started) {
+        reboot(sim);
+    }
+    profile_step(&sim->profile, true);
+    PROFILE_BEGIN();
+    if(sim->tracer == NULL && nevents >= sim->ncores) {
+        index_cores(sim);
+    }
+
+//  EXECUTE UNTIL THE LAST PROCESS HAS EXITED (AND NO MORE WILL ARRIVE)
+    long long   n   = 0;
+
+    while(n < nevents && processes_remain(sim)) {
+        execute_next_event(sim);
+        ++n;
+        if(sim->telemetry != NULL && (sim->nevents & (TELEMETRY_EVENTS-1)) == 0) {
+            sample_telemetry(sim);
+        }
+    }
+    if(sim->indexed) {
+        unindex_cores(sim);
+    }
+    PROFILE_COUNT(&sim->profile, PHASE_STEP, n);
+    PROFILE_END(&sim->profile, PHASE_STEP);
+    profile_step(&sim->profile, false);
+
+//  WE HAVE FINISHED!
+    if(!processes_remain(sim) && !sim->finished) {
+        usecs_t usecs   = sim->USECS_SINCE_REBOOT;
+
+        TRACE(sim, EVENT_SHUTDOWN, UNKNOWN, UNKNOWN, 0, 0, 0);
+        trace_flush(sim, UNKNOWN);
+        TRACE(sim, EVENT_SUMMARY, UNKNOWN, UNKNOWN, sim->total_time_on_CPU,
+                (usecs > 0) ? 100*sim->total_time_on_CPU / (sim->ncores*usecs) : 0, 0);
+        trace_flush(sim, UNKNOWN);
+        const char  *error  = close_tracer(sim);
+
+        if(error != NULL) {
+            fail(&sim->failure, "%s", error);
+        }
+        sim->finished   = true;
+    }
+    if(sim->telemetry != NULL) {
+        sample_telemetry(sim);
+    }
+    return n;
+}
+
+int ms_run(struct simulation *sim)
+{
+    return (ms_step(sim, LLONG_MAX) < 0) ? -1 : 0;
+}
+
+int ms_set_arrivals(struct simulation *sim, FILE *fp)
+{
+    if(setjmp(sim->failure.on_error) != 0) {
+        return -1;
+    }
+    if(sim->started) {
+        fail(&sim->failure, "ERROR - arrivals must be set before the simulation starts");
+    }
+    sim->arrivals   = fp;
+    return 0;
+}
+
+void ms_get_stats(const struct simulation *sim, struct ms_stats *stats)
+{
+    usecs_t usecs       = sim->USECS_SINCE_REBOOT;
+
+    stats->usecs        = usecs;
+    stats->time_on_CPU  = sim->total_time_on_CPU;
+    stats->utilization  = (usecs > 0) ? 100*sim->total_time_on_CPU / (sim->ncores*usecs) : 0;
+    stats->nprocesses   = sim->nprocesses;
+    stats->nspawned     = sim->nspawned;
+    stats->narrived     = sim->narrived;
+    stats->nevents      = sim->nevents;
+    stats->ncores       = sim->ncores;
+    stats->finished     = sim->finished;
+
+    stats->ntransfers   = 0;
+    if(sim->device_metrics != NULL) {
+        FOREACH_DEVICE(sim->w) {
+            stats->ntransfers  += sim->device_metrics[d*MS_NDEVICE_METRICS + MS_DEVICE_TRANSFER].count;
+        }
+    }
+    stats->ncoalesced   = sim->ncoalesced;
+    stats->bus_usecs_saved  = sim->ncoalesced * TIME_ACQUIRE_BUS;
+}
+
+int ms_get_core_stats(const struct simulation *sim, int k, struct ms_core_stats *stats)
+{
+    if(!sim->started || k < 0 || k >= sim->ncores) {
+        return -1;
+    }
+    struct core *core   = &sim->cores[k];
+    usecs_t usecs       = sim->USECS_SINCE_REBOOT;
+
+    stats->time_on_CPU          = core->time_on_CPU;
+    stats->time_switching       = core->time_switching;
+    stats->utilization          = (usecs > 0) ? 100*core->time_on_CPU / usecs : 0;
+    stats->ncontext_switches    = core->ncontext_switches;
+    stats->nsteals              = core->nsteals;
+    return 0;
+}
+
+static void get_latency(const struct histogram *h, struct ms_latency *latency)
+{
+    latency->count  = h->count;
+    latency->min    = h->min;
+    latency->max    = h->max;
+    latency->total  = h->total;
+    latency->p50    = histogram_percentile(h, 50.0);
+    latency->p90    = histogram_percentile(h, 90.0);
+    latency->p99    = histogram_percentile(h, 99.0);
+}
+
+int ms_get_latency(const struct simulation *sim, int metric, struct ms_latency *latency)
+{
+    if(!sim->started || metric < 0 || metric >= MS_NMETRICS) {
+        return -1;
+    }
+    get_latency(&sim->metrics[metric], latency);
+    return 0;
+}
+
+int ms_get_device_latency(const struct simulation *sim, int device, int metric,
+                          struct ms_latency *latency)
+{
+    if(!sim->started || device < 0 || device >= sim->w->ndevices ||
+       metric < 0 || metric >= MS_NDEVICE_METRICS) {
+        return -1;
+    }
+    get_latency(&sim->device_metrics[device*MS_NDEVICE_METRICS + metric], latency);
+    return 0;
+}
+
+static char *metric_names[MS_NMETRICS] = {
+    "turnaround", "response", "scheduling", "ready", "blocked", "sleeping", "waiting"
+};
+
+static char *device_metric_names[MS_NDEVICE_METRICS] = {
+    "bus_wait", "transfer"
+};
+
+static void write_latency(FILE *fp, int format, const char scope[], const char metric[],
+                          const struct histogram *h)
+{
+    struct ms_latency   l;
+
+    get_latency(h, &l);
+    double mean = (l.count > 0) ? (double)l.total / l.count : 0.0;
+
+    if(format == MS_METRICS_CSV) {
+        fprintf(fp, "%s,%s,%lli,%lli,%.1f,%lli,%lli,%lli,%lli,%lli\n", scope, metric,
+                    l.count, l.min, mean, l.p50, l.p90, l.p99, l.max, l.total);
+    }
+    else {
+        fprintf(fp, "\"%s\":{\"count\":%lli,\"min\":%lli,\"mean\":%.1f,\"p50\":%lli,"
+                    "\"p90\":%lli,\"p99\":%lli,\"max\":%lli,\"total\":%lli}",
+                    metric, l.count, l.min, mean, l.p50, l.p90, l.p99, l.max, l.total);
+    }
+}
+
+//  WRITE ALL LATENCIES, AND EACH DEVICE'S UTILIZATION OF THE DATABUS
+int ms_write_metrics(const struct simulation *sim, FILE *fp, int format)
+{
+    const struct workload *w    = sim->w;
+    usecs_t usecs               = sim->USECS_SINCE_REBOOT;
+
+    if(!sim->started || (format != MS_METRICS_JSON && format != MS_METRICS_CSV)) {
+        return -1;
+    }
+    if(format == MS_METRICS_CSV) {
+        fprintf(fp, "scope,metric,count,min,mean,p50,p90,p99,max,total\n");
+        for(int m=0 ; m<MS_NMETRICS ; ++m) {
+            write_latency(fp, format, "processes", metric_names[m], &sim->metrics[m]);
+        }
+        FOREACH_DEVICE(w) {
+            char    scope[BUFSIZ];
+
+            snprintf(scope, sizeof scope, "device.%s", DEVICE_NAME(w, d));
+            for(int m=0 ; m<MS_NDEVICE_METRICS ; ++m) {
+                write_latency(fp, format, scope, device_metric_names[m],
+                                &sim->device_metrics[d*MS_NDEVICE_METRICS + m]);
+            }
+        }
+    }
+    else {
+        fprintf(fp, "{\"usecs\":%lli,\"utilization\":%lli,\n\"processes\":{",
+                    usecs, (usecs > 0) ? 100*sim->total_time_on_CPU / (sim->ncores*usecs) : 0);
+        for(int m=0 ; m<MS_NMETRICS ; ++m) {
+            fprintf(fp, "%s\n  ", (m == 0) ? "" : ",");
+            write_latency(fp, format, "processes", metric_names[m], &sim->metrics[m]);
+        }
+        fprintf(fp, "},\n\"devices\":{");
+        FOREACH_DEVICE(w) {
+            const struct histogram *metrics = &sim->device_metrics[d*MS_NDEVICE_METRICS];
+            usecs_t busy                    = metrics[MS_DEVICE_TRANSFER].total;
+
+            fprintf(fp, "%s\n  ", (d == 0) ? "" : ",");
+            json_string(fp, DEVICE_NAME(w, d));
+            fprintf(fp, ":{\"requests\":%lli,\"utilization\":%lli",
+                        metrics[MS_DEVICE_TRANSFER].count, (usecs > 0) ? 100*busy / usecs : 0);
+            for(int m=0 ; m<MS_NDEVICE_METRICS ; ++m) {
+                fprintf(fp, ",\n    ");
+                write_latency(fp, format, DEVICE_NAME(w, d), device_metric_names[m], &metrics[m]);
+            }
+            fprintf(fp, "}");
+        }
+        fprintf(fp, "}}\n");
+    }
+    return ferror(fp) ? -1 : 0;
+}
+
+int ms_write_profile(struct simulation *sim, FILE *fp)
+{
+    if(setjmp(sim->failure.on_error) != 0) {
+        return -1;
+    }
+#ifdef MYSCHEDULER_PROFILE
+    write_profile(sim, fp);
+#else
+    (void)fp;
+    fail(&sim->failure, "ERROR - not compiled with -DMYSCHEDULER_PROFILE");
+#endif
+    return 0;
+}
+
+int ms_save_snapshot(struct simulation *sim, FILE *fp)
+{
+    if(setjmp(sim->failure.on_error) != 0) {
+        return -1;
+    }
+    save_snapshot(sim, fp);
+    return 0;
+}
+
+int ms_restore_snapshot(struct simulation *sim, FILE *fp)
+{
+    if(sim->failed) {
+        return -1;
+    }
+    if(setjmp(sim->failure.on_error) != 0) {
+        sim->failed = true;
+        close_tracer(sim);
+        return -1;
+    }
+    restore_snapshot(sim, fp);
+    return 0;
+}
+
+struct simulation *ms_fork_simulation(const struct simulation *sim, const struct ms_config *config)
+{
+    struct ms_config    same    = sim->w->config;
+
+    if(!sim->started || sim->failed || sim->arrivals != NULL) {
+        return NULL;
+    }
+    if(config == NULL) {
+        same.timequantum    = sim->timequantum;
+        same.steal_policy   = sim->steal_policy;
+        same.time_steal     = sim->time_steal;
+        same.seed           = sim->seed;
+        same.trace          = NULL;
+        config              = &same;
+    }
+
+    struct simulation   *child  = ms_new_simulation(sim->w, config);
+
+    if(child == NULL) {
+        return NULL;
+    }
+    if(setjmp(child->failure.on_error) != 0) {
+        ms_free_simulation(child);
+        return NULL;
+    }
+    fork_simulation(child, (struct simulation *)sim);
+    return child;
+}
+
+int ms_set_telemetry(struct simulation *sim, const char path[], int kind, int interval_msecs)
+{
+    if(setjmp(sim->failure.on_error) != 0) {
+        close_telemetry(sim);
+        return -1;
+    }
+    if(sim->telemetry != NULL) {
+        fail(&sim->failure, "ERROR - telemetry is already being published");
+    }
+    open_telemetry(sim, path, kind == MS_TELEMETRY_SOCKET, interval_msecs);
+    return 0;
+}
+
+const char *ms_simulation_error(const struct simulation *sim)
+{
+    return sim->failure.message;
+}
+
+void ms_free_simulation(struct simulation *sim)
+{
+    if(sim != NULL) {
+        close_tracer(sim);
+        close_telemetry(sim);
+        close_profile(&sim->profile);
+        free(sim->processes);
+        free(sim->histories);
+        free(sim->IO_BLOCKED_queues);
+        if(sim->buses != NULL) {
+            FOREACH_BUS(sim) {
+                free(sim->buses[b].pending);
+            }
+        }
+        free(sim->buses);
+        if(sim->cores != NULL) {
+            FOREACH_CORE(sim) {
+                free(sim->cores[k].READY_heap);
+            }
+        }
+        free(sim->cores);
+        free(sim->childless);
+        free(sim->SLEEPING_queue);
+        free(sim->awakening);
+        free(sim->metrics);
+        free(sim->device_metrics);
+        free(sim->arrival_line);
+        free(sim->busy_cores);
+        free(sim->idle_cores);
+        free(sim->idle_index);
+        free(sim);
+    }
+}
+
+//  ----------------------------------------------------------------------
+
+//  THE REST OF THIS FILE IS THE myscheduler PROGRAM, USING THE LIBRARY API
+#ifndef MYSCHEDULER_LIBRARY
+
+//  THE AUTOTUNER SEARCHES A RANGE OF timequantum VALUES, OPTIONALLY JOINTLY
+//  WITH THE NUMBER OF cores AND THE stealcost, SIMULATING EACH CANDIDATE.
+//  ALL CANDIDATES SHARE THE ONE (READ-ONLY) workload, AND ARE SIMULATED BY
+//  AS MANY THREADS AS THE HOST HAS ONLINE CPUs.
+//
+//  EVERY CANDIDATE EXECUTES THE SAME PROCESSES (DRAWING THE SAME RANDOM
+//  VALUES), SO THE TOTAL usecs ONCPU IS THE SAME FOR ALL OF THEM, AND AMONG
+//  CANDIDATES WITH THE SAME NUMBER OF cores A LONGER MAKESPAN ALSO MEANS A
+//  LOWER UTILIZATION.  A CANDIDATE WHOSE CLOCK PASSES THE BEST MAKESPAN FOUND
+//  SO FAR FOR ITS NUMBER OF cores IS THEREFORE DOMINATED, AND IS ABANDONED
+//  (PRUNED) WITHOUT CHANGING THE FRONT.
+
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define TUNE_TIMEQUANTUM        0
+#define TUNE_CORES              1
+#define TUNE_STEALCOST          2
+#define NTUNABLES               3
+
+char *tunables[NTUNABLES]   = { "timequantum", "cores", "stealcost" };
+
+#define DEFAULT_TUNE_LO         10
+#define DEFAULT_TUNE_HI         500
+#define DEFAULT_TUNE_STEP       10
+
+//  HOW MANY EVENTS A CANDIDATE EXECUTES BETWEEN CHECKS FOR PRUNING
+#define PRUNE_INTERVAL          64
+
+//  THE MOST CANDIDATES THAT MAY BE SEARCHED
+#define MAX_CANDIDATES          1000000
+
+struct tuning_range {
+    long long   lo, hi, step;
+    bool        given;                  // on the command-line?
+} tuning[NTUNABLES];
+
+#define CANDIDATE_FAILED        0
+#define CANDIDATE_FINISHED      1
+#define CANDIDATE_PRUNED        2
+
+struct candidate {
+    long long   value[NTUNABLES];
+    int         status;
+    usecs_t     makespan;
+    usecs_t     total_time_on_CPU;
+    struct ms_latency   scheduling;     // its processes' waits when READY
+} *candidates   = NULL;
+int ncandidates = 0;
+
+atomic_int  next_candidate;             // the next to be simulated
+
+//  THE BEST MAKESPAN FOUND SO FAR, INDEXED BY NUMBER OF cores
+_Atomic usecs_t *best_makespan  = NULL;
+
+//  PARSE ONE COMMAND-LINE tunable=lo:hi[:step] OR tunable=value
+bool parse_tuning_range(char argv0[], char arg[])
+{
+    char        *eq     = strchr(arg, '=');
+
+    if(eq == NULL) {
+        return false;
+    }
+    for(int t=0 ; t<NTUNABLES ; ++t) {
+        if(strlen(tunables[t]) == (size_t)(eq-arg) && strncmp(tunables[t], arg, eq-arg) == 0) {
+            struct tuning_range *r  = &tuning[t];
+
+            r->step     = 1;
+            int n       = sscanf(eq+1, "%lli:%lli:%lli", &r->lo, &r->hi, &r->step);
+            if(n == 1) {
+                r->hi   = r->lo;
+            }
+            if(n < 1 || r->lo < (t == TUNE_STEALCOST ? 0 : 1) || r->hi < r->lo || r->step < 1) {
+                printf("%s: invalid autotune range '%s'\n", argv0, arg);
+                exit(EXIT_FAILURE);
+            }
+            r->given    = true;
+            return true;
+        }
+    }
+    printf("%s: cannot autotune '%s'\n", argv0, arg);
+    exit(EXIT_FAILURE);
+}
+
+//  tunables NOT GIVEN ON THE COMMAND-LINE KEEP THEIR sysconfig VALUES,
+//  EXCEPT timequantum WHICH IS ALWAYS SEARCHED
+void default_tuning_ranges(struct ms_config *config)
+{
+    long long   sysconfig[NTUNABLES]    = { config->timequantum, config->ncores, config->time_steal };
+
+    for(int t=0 ; t<NTUNABLES ; ++t) {
+        if(!tuning[t].given) {
+            tuning[t].lo    = tuning[t].hi  = sysconfig[t];
+            tuning[t].step  = 1;
+        }
+    }
+    if(!tuning[TUNE_TIMEQUANTUM].given) {
+        tuning[TUNE_TIMEQUANTUM].lo     = DEFAULT_TUNE_LO;
+        tuning[TUNE_TIMEQUANTUM].hi     = DEFAULT_TUNE_HI;
+        tuning[TUNE_TIMEQUANTUM].step   = DEFAULT_TUNE_STEP;
+    }
+}
+
+//  ENUMERATE THE CARTESIAN PRODUCT OF ALL tuning RANGES
+void make_candidates(char argv0[])
+{
+    long long   n   = 1;
+
+    for(int t=0 ; t<NTUNABLES ; ++t) {
+        n  *= (tuning[t].hi - tuning[t].lo) / tuning[t].step + 1;
+        if(n > MAX_CANDIDATES) {
+            printf("%s: too many autotune candidates (more than %i)\n", argv0, MAX_CANDIDATES);
+            exit(EXIT_FAILURE);
+        }
+    }
+    ncandidates     = n;
+    candidates      = calloc(ncandidates, sizeof candidates[0]);
+    best_makespan   = calloc(tuning[TUNE_CORES].hi+1, sizeof best_makespan[0]);
+    if(candidates == NULL || best_makespan == NULL) {
+        perror(argv0);
+        exit(EXIT_FAILURE);
+    }
+    for(long long k=0 ; k<=tuning[TUNE_CORES].hi ; ++k) {
+        atomic_init(&best_makespan[k], LLONG_MAX);
+    }
+
+    int c   = 0;
+    for(long long k=tuning[TUNE_CORES].lo ; k<=tuning[TUNE_CORES].hi ; k+=tuning[TUNE_CORES].step) {
+        for(long long s=tuning[TUNE_STEALCOST].lo ; s<=tuning[TUNE_STEALCOST].hi ; s+=tuning[TUNE_STEALCOST].step) {
+            for(long long q=tuning[TUNE_TIMEQUANTUM].lo ; q<=tuning[TUNE_TIMEQUANTUM].hi ; q+=tuning[TUNE_TIMEQUANTUM].step) {
+                candidates[c].value[TUNE_TIMEQUANTUM]   = q;
+                candidates[c].value[TUNE_CORES]         = k;
+                candidates[c].value[TUNE_STEALCOST]     = s;
+                candidates[c].status                    = CANDIDATE_FAILED;
+                ++c;
+            }
+        }
+    }
+}
+
+void run_candidate(const struct workload *w, struct candidate *cand)
+{
+    struct ms_config    config;
+    struct ms_stats     stats;
+
+    ms_default_config(w, &config);
+    config.timequantum  = cand->value[TUNE_TIMEQUANTUM];
+    config.ncores       = cand->value[TUNE_CORES];
+    config.time_steal   = cand->value[TUNE_STEALCOST];
+    config.trace        = NULL;
+
+    struct simulation *sim  = ms_new_simulation(w, &config);
+    _Atomic usecs_t *best   = &best_makespan[config.ncores];
+
+    while(sim != NULL && ms_step(sim, PRUNE_INTERVAL) >= 0) {
+        ms_get_stats(sim, &stats);
+
+        if(stats.finished) {
+            cand->makespan          = stats.usecs;
+            cand->total_time_on_CPU = stats.time_on_CPU;
+            cand->status            = CANDIDATE_FINISHED;
+            ms_get_latency(sim, MS_METRIC_SCHEDULING, &cand->scheduling);
+
+//  LOWER THE BEST MAKESPAN, UNLESS ANOTHER CANDIDATE HAS ALREADY DONE BETTER
+            usecs_t old = atomic_load(best);
+            while(stats.usecs < old &&
+                  !atomic_compare_exchange_weak(best, &old, stats.usecs)) {
+                ;
+            }
+            break;
+        }
+        if(stats.usecs > atomic_load_explicit(best, memory_order_relaxed)) {
+            cand->status    = CANDIDATE_PRUNED;
+            break;
+        }
+    }
+    ms_free_simulation(sim);
+}
+
+void *autotune_worker(void *workload)
+{
+    for(;;) {
+        int c   = atomic_fetch_add(&next_candidate, 1);
+
+        if(c >= ncandidates) {
+            break;
+        }
+        run_candidate(workload, &candidates[c]);
+    }
+    return NULL;
+}
+
+double candidate_utilization(struct candidate *cand)
+{
+    return (double)cand->total_time_on_CPU / (cand->value[TUNE_CORES] * cand->makespan);
+}
+
+//  ORDER FINISHED CANDIDATES BY INCREASING MAKESPAN, THEN DECREASING UTILIZATION
+int compare_candidates(const void *p1, const void *p2)
+{
+    struct candidate *c1    = *(struct candidate **)p1;
+    struct candidate *c2    = *(struct candidate **)p2;
+
+    if(c1->makespan != c2->makespan) {
+        return (c1->makespan < c2->makespan) ? -1 : 1;
+    }
+    double u1   = candidate_utilization(c1);
+    double u2   = candidate_utilization(c2);
+    return (u1 > u2) ? -1 : (u1 < u2);
+}
+
+//  REPORT THE CANDIDATES NOT DOMINATED IN BOTH MAKESPAN AND UTILIZATION
+void report_pareto_front(void)
+{
+    struct candidate **finished = malloc(ncandidates * sizeof finished[0]);
+    int nfinished = 0, npruned = 0;
+
+    if(finished == NULL) {
+        perror(__func__);
+        exit(EXIT_FAILURE);
+    }
+    for(int c=0 ; c<ncandidates ; ++c) {
+        if(candidates[c].status == CANDIDATE_FINISHED) {
+            finished[nfinished++]   = &candidates[c];
+        }
+        else if(candidates[c].status == CANDIDATE_PRUNED) {
+            ++npruned;
+        }
+    }
+    printf("autotune  %i  %i  %i  %i\n",
+            ncandidates, nfinished, npruned, ncandidates-nfinished-npruned);
+    qsort(finished, nfinished, sizeof finished[0], compare_candidates);
+
+//  SWEEPING BY MAKESPAN, A CANDIDATE IS ON THE FRONT IF IT IMPROVES THE BEST
+//  UTILIZATION SEEN, OR EXACTLY TIES THE CANDIDATE THAT FIRST ACHIEVED IT
+    double  best_util       = -1.0;
+    usecs_t best_util_at    = UNKNOWN;
+    for(int f=0 ; f<nfinished ; ++f) {
+        struct candidate *cand  = finished[f];
+        double util             = candidate_utilization(cand);
+
+        if(util > best_util || (util == best_util && cand->makespan == best_util_at)) {
+            if(util > best_util) {
+                best_util       = util;
+                best_util_at    = cand->makespan;
+            }
+            printf("pareto  %lli  %lli  %lli  %lli  %lli  %lli  %lli\n",
+                    cand->value[TUNE_TIMEQUANTUM], cand->value[TUNE_CORES],
+                    cand->value[TUNE_STEALCOST], cand->makespan,
+                    100*cand->total_time_on_CPU / (cand->value[TUNE_CORES]*cand->makespan),
+                    cand->scheduling.p50, cand->scheduling.p99);
+        }
+    }
+    free(finished);
+}
+
+//  SIMULATE ALL CANDIDATES, WITH ONE THREAD PER ONLINE HOST CPU
+void autotune(char argv0[], const struct workload *w)
+{
+    struct ms_config    config;
+    long                nworkers    = sysconf(_SC_NPROCESSORS_ONLN);
+
+    ms_default_config(w, &config);
+    default_tuning_ranges(&config);
+    make_candidates(argv0);
+    atomic_init(&next_candidate, 0);
+
+    if(nworkers < 1) {
+        nworkers    = 1;
+    }
+    if(nworkers > ncandidates) {
+        nworkers    = ncandidates;
+    }
+
+    pthread_t   workers[nworkers];
+    for(int t=0 ; t<nworkers ; ++t) {
+        if(pthread_create(&workers[t], NULL, autotune_worker, (void *)w) != 0) {
+            printf("%s: cannot create autotuning thread\n", argv0);
+            exit(EXIT_FAILURE);
+        }
+    }
+    for(int t=0 ; t<nworkers ; ++t) {
+        pthread_join(workers[t], NULL);
+    }
+    report_pareto_front();
+}
+
+//  ----------------------------------------------------------------------
+
+//  A WORKLOAD OF STOCHASTIC COMMANDS IS REPLICATED MANY TIMES, REPLICATION r
+//  USING THE sysconfig's seed+r, BY AS MANY THREADS AS THE HOST HAS ONLINE
+//  CPUs.  EACH REPLICATION'S RESULTS ARE STORED BY ITS INDEX, SO THE REPORT IS
+//  IDENTICAL HOWEVER MANY THREADS SIMULATE THEM.  THE MEAN MAKESPAN AND
+//  UTILIZATION, AND THEIR MEDIAN AND 95TH PERCENTILE, ARE EACH REPORTED WITH
+//  A 95% CONFIDENCE INTERVAL (THOSE OF PERCENTILES FROM ORDER STATISTICS).
+
+#define CONFIDENCE_Z            1.96    // of a two-sided 95% interval
+
+struct replication {
+    bool        finished;
+    double      makespan;
+    double      utilization;            // percentage
+} *replications = NULL;
+int nreplications   = 0;
+
+atomic_int  next_replication;           // the next to be simulated
+
+void run_replication(const struct workload *w, int r)
+{
+    struct ms_config    config;
+    struct ms_stats     stats;
+
+    ms_default_config(w, &config);
+    config.seed     += r;
+    config.trace    = NULL;
+
+    struct simulation *sim  = ms_new_simulation(w, &config);
+
+    if(sim != NULL && ms_run(sim) == 0) {
+        ms_get_stats(sim, &stats);
+        replications[r].finished    = true;
+        replications[r].makespan    = stats.usecs;
+        replications[r].utilization = (stats.usecs > 0) ?
+                        100.0*stats.time_on_CPU / ((double)stats.ncores*stats.usecs) : 0.0;
+    }
+    ms_free_simulation(sim);
+}
 
-//  AN ARRAY AND FUNCTIONS TO MANAGE THE SYSTEM'S SLEEPING QUEUE
+void *replication_worker(void *workload)
+{
+    for(;;) {
+        int r   = atomic_fetch_add(&next_replication, 1);
 
-struct {
-    int         proc;                   // index into processes[]
-    int         until;                  // when the process awakens
-} SLEEPING_queue[MAX_RUNNING_PROCESSES];
+        if(r >= nreplications) {
+            break;
+        }
+        run_replication(workload, r);
+    }
+    return NULL;
+}
 
-int nsleeping               = 0;
-#define FOREACH_SLEEPER     for(int s=0 ; s<nsleeping ; ++s)
+int compare_doubles(const void *p1, const void *p2)
+{
+    double  d1  = *(const double *)p1;
+    double  d2  = *(const double *)p2;
+
+    return (d1 < d2) ? -1 : (d1 > d2);
+}
 
-void init_SLEEPING_queue(void)
+//  THE q'TH QUANTILE OF n SORTED VALUES, AND THE VALUES OF THE RANKS BOUNDING
+//  ITS CONFIDENCE INTERVAL, FROM THE NORMAL APPROXIMATION OF THE BINOMIAL
+void print_quantile(const double sorted[], int n, double q)
 {
-    nsleeping   = 0;
+    double  spread  = CONFIDENCE_Z * sqrt(n * q * (1.0-q));
+    int     at      = (int)ceil(n*q) - 1;
+    int     lo      = (int)floor(n*q - spread) - 1;
+    int     hi      = (int)ceil(n*q + spread) - 1;
+
+    at  = (at < 0) ? 0 : at;
+    lo  = (lo < 0) ? 0 : lo;
+    hi  = (hi > n-1) ? n-1 : hi;
+    printf("  %.2f  %.2f  %.2f", sorted[at], sorted[lo], sorted[hi]);
 }
 
-void append_to_SLEEPING_queue(int proc_on_CPU, int duration)
+//  REPORT THE MEAN, MEDIAN, AND 95TH PERCENTILE, EACH WITH ITS CONFIDENCE INTERVAL
+void report_statistic(const char name[], double values[], int n)
 {
-    DEBUG("sleep %i, pid%i.RUNNING->SLEEPING", duration, processes[proc_on_CPU].pid);
+    double  sum = 0.0, sumsq = 0.0;
 
-    processes[proc_on_CPU].state        = STATE_SLEEPING;
-    SLEEPING_queue[nsleeping].proc      = proc_on_CPU;
-//  NOTE WE'RE STORING THE TIME THE PROCESS WAKES UP, NOT JUST THE SLEEPING TIME
-    SLEEPING_queue[nsleeping].until     = USECS_SINCE_REBOOT+duration+1;
-    ++nsleeping;
+    for(int r=0 ; r<n ; ++r) {
+        sum    += values[r];
+    }
+    double  mean    = sum / n;
+
+    for(int r=0 ; r<n ; ++r) {
+        sumsq  += (values[r]-mean) * (values[r]-mean);
+    }
+    double  halfwidth   = (n > 1) ? CONFIDENCE_Z * sqrt(sumsq / (n-1) / n) : 0.0;
+
+    qsort(values, n, sizeof values[0], compare_doubles);
+    printf("%s  %.2f  %.2f  %.2f", name, mean, mean-halfwidth, mean+halfwidth);
+    print_quantile(values, n, 0.50);
+    print_quantile(values, n, 0.95);
+    printf("\n");
 }
 
-void unblock_SLEEPING(void)
+//  SIMULATE ALL REPLICATIONS, WITH ONE THREAD PER ONLINE HOST CPU
+void replicate(char argv0[], const struct workload *w, int n)
 {
-    int ORIG_USECS  = USECS_SINCE_REBOOT;
+    long    nworkers    = sysconf(_SC_NPROCESSORS_ONLN);
 
-    FOREACH_SLEEPER {
-        if(SLEEPING_queue[s].until <= ORIG_USECS) {
+    nreplications   = n;
+    replications    = calloc(n, sizeof replications[0]);
+    if(replications == NULL) {
+        perror(argv0);
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&next_replication, 0);
 
-            append_to_READY_queue(SLEEPING_queue[s].proc, "SLEEPING");
-            advance_time(TIME_CORE_STATE_TRANSITIONS);
+    if(nworkers < 1) {
+        nworkers    = 1;
+    }
+    if(nworkers > nreplications) {
+        nworkers    = nreplications;
+    }
 
-            for(int t=s ; t<(nsleeping-1) ; ++t) {      // 'slide' all left by 1
-                SLEEPING_queue[t]   = SLEEPING_queue[t+1];
-            }
-            --nsleeping;
-            --s;
+    pthread_t   workers[nworkers];
+    for(int t=0 ; t<nworkers ; ++t) {
+        if(pthread_create(&workers[t], NULL, replication_worker, (void *)w) != 0) {
+            printf("%s: cannot create replication thread\n", argv0);
+            exit(EXIT_FAILURE);
+        }
+    }
+    for(int t=0 ; t<nworkers ; ++t) {
+        pthread_join(workers[t], NULL);
+    }
+
+//  ONLY FINISHED REPLICATIONS CONTRIBUTE TO THE STATISTICS
+    double  *makespans      = malloc(n * sizeof makespans[0]);
+    double  *utilizations   = malloc(n * sizeof utilizations[0]);
+    int     nfinished       = 0;
+
+    if(makespans == NULL || utilizations == NULL) {
+        perror(argv0);
+        exit(EXIT_FAILURE);
+    }
+    for(int r=0 ; r<n ; ++r) {
+        if(replications[r].finished) {
+            makespans[nfinished]    = replications[r].makespan;
+            utilizations[nfinished] = replications[r].utilization;
+            ++nfinished;
         }
     }
+    printf("replications  %i  %i\n", n, nfinished);
+    if(nfinished > 0) {
+        report_statistic("makespan", makespans, nfinished);
+        report_statistic("utilization", utilizations, nfinished);
+    }
+    free(makespans);
+    free(utilizations);
+    free(replications);
 }
 
 //  ----------------------------------------------------------------------
 
-#include <time.h>           // only used to report real-world rebooting time
+//  WHILE EXECUTING, EVERY interval usecs OF SIMULATED TIME, REPORT THE PROCESSES
+//  ARRIVING AND EXITING, THE UTILIZATION, AND THE MEAN TURNAROUND OF THOSE
+//  EXITING DURING THAT WINDOW, AND THE NUMBER STILL RUNNING AT ITS END
+
+struct window {
+    usecs_t     usecs;
+    long long   narrived, nexited;
+    usecs_t     time_on_CPU;            // by all cores
+    long long   nturnaround;
+    usecs_t     turnaround;
+};
 
-int execute_commands(int first)
+void get_window(struct simulation *sim, struct window *win, struct ms_stats *stats)
 {
-    int proc_on_CPU         = UNKNOWN;
-    int total_time_on_CPU   = 0;
-    int timequantum_expires = UNKNOWN;
+    struct ms_latency       turnaround;
+    struct ms_core_stats    core;
+
+    ms_get_stats(sim, stats);
+    ms_get_latency(sim, MS_METRIC_TURNAROUND, &turnaround);
+    win->usecs          = stats->usecs;
+    win->narrived       = stats->narrived;
+    win->nexited        = stats->nspawned - stats->nprocesses;
+    win->nturnaround    = turnaround.count;
+    win->turnaround     = turnaround.total;
+    win->time_on_CPU    = 0;
+    for(int k=0 ; k<stats->ncores ; ++k) {
+        if(ms_get_core_stats(sim, k, &core) == 0) {
+            win->time_on_CPU   += core.time_on_CPU;
+        }
+    }
+}
 
-    USECS_SINCE_REBOOT      = 0;
+void report_windows(struct simulation *sim, usecs_t interval)
+{
+    struct window   last, now;
+    struct ms_stats stats;
+    usecs_t         next    = interval;
+
+    memset(&last, 0, sizeof last);
+    do {
+        if(ms_step(sim, 1) < 0) {
+            printf("%s\n", ms_simulation_error(sim));
+            exit(EXIT_FAILURE);
+        }
+        ms_get_stats(sim, &stats);
 
-//  THESE 4 LINES NOT PART OF THE PROJECT, JUST USED TO REPORT REAL-WORLD TIME
-    time_t      now;
-    time(&now);
-    char *t = ctime(&now);
-    t[19]   = '\0';
+        if(stats.usecs >= next || stats.finished) {
+            get_window(sim, &now, &stats);
 
-    DEBUG("REBOOTING at %s, with timequantum=%i", t, timequantum);
-    flush_DEBUG(UNKNOWN);
-    spawn_process(first, UNKNOWN);
-    flush_DEBUG(UNKNOWN);
+            usecs_t     elapsed = now.usecs - last.usecs;
+            long long   nturned = now.nturnaround - last.nturnaround;
 
-    USECS_SINCE_REBOOT      = -1;   // not a mistake
+            printf("window  %lli  %lli  %lli  %i  %i  %lli\n", now.usecs,
+                    now.narrived - last.narrived, now.nexited - last.nexited, stats.nprocesses,
+                    (elapsed > 0) ? (int)(100*(now.time_on_CPU - last.time_on_CPU) / (stats.ncores*elapsed)) : 0,
+                    (nturned > 0) ? (now.turnaround - last.turnaround) / nturned : 0);
+            fflush(stdout);
+            last    = now;
+            next    = (now.usecs / interval + 1) * interval;
+        }
+    } while(!stats.finished);
+}
 
-//  EXECUTE UNTIL THE LAST PROCESS HAS EXITED
-    while(nprocesses > 0) {
-        advance_time(1);
+//  ----------------------------------------------------------------------
 
-//  IS A PROCESS RUNNING ON THE CPU?
-        if(proc_on_CPU != UNKNOWN) {
-            int c       = processes[proc_on_CPU].command;
-            int s       = processes[proc_on_CPU].next_syscall;
+//  THE BENCHMARKS MEASURE THE SIMULATOR ITSELF, ON SYNTHETIC WORKLOADS OF
+//  A GIVEN scale, EACH REPORTED AS ONE LINE OF JSON.  EACH BENCHMARK RUNS IN
+//  ITS OWN CHILD PROCESS, SO THAT ITS PEAK RESIDENT SET SIZE IS ITS OWN.
+//  --generate WRITES THE SAME WORKLOADS TO FILES.
+
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+//  ALL BENCHMARKS SHARE THIS sysconfig
+char *benchmark_sysconfig   =
+    "device  ssd     500000000   300000000\n"
+    "device  disk    100000000   80000000\n"
+    "device  net     12500000    12500000\n"
+    "timequantum     100\n"
+    "cores           4\n";
+
+//  A SMALL, DETERMINISTIC PSEUDO-RANDOM GENERATOR, RETURNING [lo, hi]
+long long random_between(unsigned long long *seed, long long lo, long long hi)
+{
+    *seed   = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return lo + (long long)((*seed >> 33) % (unsigned long long)(hi - lo + 1));
+}
 
-//  THE RUNNING PROCESS ISSUES A SYSTEM-CALL, IT WILL LOSE THE CPU
-            if(processes[proc_on_CPU].time_on_CPU == commands[c].syscalls[s].when) {
-                int which       = commands[c].syscalls[s].which;
-                ++processes[proc_on_CPU].next_syscall;
-
-                switch (which) {
-                    case SYS_SPAWN:
-                        spawn_process(commands[c].syscalls[s].arg0, processes[proc_on_CPU].pid);
-                        ++processes[proc_on_CPU].nchildren;
-                        append_to_READY_queue(proc_on_CPU, "RUNNING");
-                        advance_time(TIME_CORE_STATE_TRANSITIONS);
-                        break;
-
-                    case SYS_READ:
-                    case SYS_WRITE:
-                        append_to_IO_BLOCKED_queue(proc_on_CPU, which,
-                            commands[c].syscalls[s].arg0, commands[c].syscalls[s].arg1);
-                        processes[proc_on_CPU].state    = STATE_IO_BLOCKED;
-                        break;
-
-                    case SYS_SLEEP:
-                        append_to_SLEEPING_queue(proc_on_CPU, commands[c].syscalls[s].arg0);
-                        advance_time(TIME_CORE_STATE_TRANSITIONS);
-                        break;
-
-                    case SYS_WAIT:
-                        if(processes[proc_on_CPU].nchildren == 0) {
-                            DEBUG("wait (but no child processes)");
-                            append_to_READY_queue(proc_on_CPU, "RUNNING");
-                            flush_DEBUG(processes[proc_on_CPU].command);
-                        }
-                        else {
-                            append_to_WAITING_queue(proc_on_CPU);
-                        }
-                        advance_time(TIME_CORE_STATE_TRANSITIONS);
-                        break;
-
-                    case SYS_EXIT:
-                        total_time_on_CPU   += processes[proc_on_CPU].time_on_CPU;
-                        exit_process(proc_on_CPU);
-                        break;
-
-                    default:
-                        printf("ERROR - unknown syscall %i\n", which);
-                        exit(EXIT_FAILURE);
-                        break;
-                }
-//  EACH SYSTEM-CALL HAS RESULTED IN ITS PROCESS LEAVING THE CPU
-                proc_on_CPU     = UNKNOWN;
-                flush_DEBUG(UNKNOWN);
-            }
+#define NVARIANTS               8       // distinct commands of randomized workloads
 
-//  IF A PROCESS IS ON THE CPU...
-            if(proc_on_CPU != UNKNOWN) {
+//  THE FIRST COMMAND SPAWNS scale CHILDREN, CYCLING THROUGH THE VARIANTS, THEN WAITS
+void generate_parent(FILE *fp, int scale, const char child[], int nvariants)
+{
+    fprintf(fp, "main\n");
+    for(int n=0 ; n<scale ; ++n) {
+        fprintf(fp, "\t%iusecs\tspawn\t%s%i\n", n+1, child, n % nvariants);
+    }
+    fprintf(fp, "\t%iusecs\twait\n\t%iusecs\texit\n#\n", scale+1, scale+2);
+}
 
-//  PROCESS ON CPU HAS CONSUMED SOME CPU (COMPUTATION) TIME
-                ++processes[proc_on_CPU].time_on_CPU;
-                if(verbose) {
-                    DEBUG("c"); flush_DEBUG(proc_on_CPU);
-                }
+//  A BINARY TREE OF SPAWNS, scale LEVELS DEEP, EACH PARENT WAITING FOR BOTH CHILDREN.
+//  THE TREE IS THE SAME FOR EVERY seed.
+void generate_tree(FILE *fp, int scale, unsigned long long *seed)
+{
+    (void)seed;
+    for(int d=0 ; d<scale ; ++d) {
+        fprintf(fp, "tree%i\n\t10usecs\tspawn\ttree%i\n\t20usecs\tspawn\ttree%i\n", d, d+1, d+1);
+        fprintf(fp, "\t30usecs\twait\n\t40usecs\texit\n#\n");
+    }
+    fprintf(fp, "tree%i\n\t200usecs\texit\n#\n", scale);
+}
 
-//  HAS THE RUNNING PROCESS'S TIME QUANTUM EXPIRED?
-                if(USECS_SINCE_REBOOT >= timequantum_expires) {
-                    DEBUG("timequantum expired");
-                    append_to_READY_queue(proc_on_CPU, "RUNNING");
-                    proc_on_CPU = UNKNOWN;
-                    advance_time(TIME_CORE_STATE_TRANSITIONS);
-                }
-            }
+//  ONE PARENT SPAWNING scale CHILDREN, THEN WAITING FOR THEM ALL
+void generate_fanout(FILE *fp, int scale, unsigned long long *seed)
+{
+    generate_parent(fp, scale, "child", NVARIANTS);
+    for(int v=0 ; v<NVARIANTS ; ++v) {
+        fprintf(fp, "child%i\n\t%lliusecs\texit\n#\n", v, random_between(seed, 50, 500));
+    }
+}
+
+//  scale PROCESSES, EACH READING AND WRITING ALL DEVICES
+void generate_io(FILE *fp, int scale, unsigned long long *seed)
+{
+    char    *devices[]  = { "ssd", "disk", "net" };
+
+    generate_parent(fp, scale, "io", NVARIANTS);
+    for(int v=0 ; v<NVARIANTS ; ++v) {
+        long long   when    = 0;
+
+        fprintf(fp, "io%i\n", v);
+        for(int s=0 ; s<20 ; ++s) {
+            when   += random_between(seed, 10, 100);
+            fprintf(fp, "\t%lliusecs\t%s\t%s\t%lliB\n", when, (s % 3 == 0) ? "write" : "read",
+                        devices[random_between(seed, 0, 2)], random_between(seed, 1000, 1000000));
         }
+        fprintf(fp, "\t%lliusecs\texit\n#\n", when+10);
+    }
+}
 
-//  IF CPU IS NOW IDLE AND PROCESSES REMAIN....
-        if(proc_on_CPU == UNKNOWN && nprocesses > 0) {
-            unblock_SLEEPING();
-            unblock_WAITING();
-            unblock_completed_IO();
-            start_pending_IO();
+//  scale PROCESSES, EACH SLEEPING MANY TIMES
+void generate_sleep(FILE *fp, int scale, unsigned long long *seed)
+{
+    generate_parent(fp, scale, "sleeper", NVARIANTS);
+    for(int v=0 ; v<NVARIANTS ; ++v) {
+        long long   when    = 0;
+
+        fprintf(fp, "sleeper%i\n", v);
+        for(int s=0 ; s<20 ; ++s) {
+            when   += random_between(seed, 5, 50);
+            fprintf(fp, "\t%lliusecs\tsleep\t%lliusecs\n", when, random_between(seed, 100, 10000));
+        }
+        fprintf(fp, "\t%lliusecs\texit\n#\n", when+10);
+    }
+}
 
-//  IDLE CPU CAN RECEIVE THE FIRST READY PROCESS
-            if(nready > 0) {
-                proc_on_CPU         = dequeue_READY_queue();
-                timequantum_expires = USECS_SINCE_REBOOT + timequantum; // new TQ
+//  scale PROCESSES, EACH COMPUTING FOR A LONG TIME (MANY timequantums)
+void generate_cpu(FILE *fp, int scale, unsigned long long *seed)
+{
+    generate_parent(fp, scale, "hog", NVARIANTS);
+    for(int v=0 ; v<NVARIANTS ; ++v) {
+        fprintf(fp, "hog%i\n\t%lliusecs\texit\n#\n", v, random_between(seed, 500000, 1000000));
+    }
+}
 
-                DEBUG("pid%i now on CPU, gets new timequantum", processes[proc_on_CPU].pid);
-                flush_DEBUG(proc_on_CPU);
-            }
+struct generator {
+    char        *name;
+    void        (*generate)(FILE *fp, int scale, unsigned long long *seed);
+    int         scale;                  // by default
+} generators[] = {
+    { "tree",   generate_tree,      12 },
+    { "fanout", generate_fanout,    5000 },
+    { "io",     generate_io,        1000 },
+    { "sleep",  generate_sleep,     2000 },
+    { "cpu",    generate_cpu,       64 },
+    { NULL }
+};
 
-//  STILL IDLE?
-            if(proc_on_CPU == UNKNOWN && verbose) {
-                DEBUG("idle"); flush_DEBUG(UNKNOWN);
-            }
+#define BENCHMARK_SEED          2002
+
+//  PARSE A COMMAND-LINE name[:scale], RETURNING THE GENERATOR (OR NULL) AND ITS scale
+struct generator *parse_generator(char arg[], int *scale)
+{
+    char    *colon  = strchr(arg, ':');
+    int     length  = (colon == NULL) ? (int)strlen(arg) : colon - arg;
+
+    for(struct generator *g=generators ; g->name != NULL ; ++g) {
+        if(word_is(arg, length, g->name)) {
+            *scale  = (colon == NULL) ? g->scale : atoi(colon+1);
+            return (*scale > 0) ? g : NULL;
         }
-    }                                   // while(nprocesses > 0)
+    }
+    return NULL;
+}
 
-//  WE HAVE FINISHED!
-    DEBUG("nprocesses=0, SHUTDOWN");
-    flush_DEBUG(UNKNOWN);
+bool generate(const struct generator *g, int scale, char sysconfig[], char commands[])
+{
+    FILE    *fp1    = fopen(sysconfig, "w");
+    FILE    *fp2    = fopen(commands, "w");
+    unsigned long long  seed    = BENCHMARK_SEED;
+    bool    ok      = (fp1 != NULL && fp2 != NULL);
+
+    if(ok) {
+        fputs(benchmark_sysconfig, fp1);
+        g->generate(fp2, scale, &seed);
+    }
+    if(fp1 != NULL && fclose(fp1) != 0) {
+        ok  = false;
+    }
+    if(fp2 != NULL && fclose(fp2) != 0) {
+        ok  = false;
+    }
+    return ok;
+}
+
+double seconds_since(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+//  GENERATE, LOAD, AND EXECUTE ONE WORKLOAD, REPORTING HOW LONG EACH TOOK
+void run_benchmark(char argv0[], const struct generator *g, int scale)
+{
+    const char  *tmpdir = (getenv("TMPDIR") != NULL) ? getenv("TMPDIR") : "/tmp";
+    char        sysconfig[BUFSIZ], commands[BUFSIZ];
+    int         fd1, fd2;
+
+    snprintf(sysconfig, sizeof sysconfig, "%s/myscheduler-sysconfig-XXXXXX", tmpdir);
+    snprintf(commands,  sizeof commands,  "%s/myscheduler-commands-XXXXXX",  tmpdir);
+    if((fd1 = mkstemp(sysconfig)) < 0 || (fd2 = mkstemp(commands)) < 0 ||
+       close(fd1) != 0 || close(fd2) != 0 || !generate(g, scale, sysconfig, commands)) {
+        printf("%s: cannot create workload files in '%s'\n", argv0, tmpdir);
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat st;
+    stat(commands, &st);
+
+//  READ THE GENERATED FILES
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    struct workload *w  = ms_new_workload(NULL);
+
+    if(w == NULL || ms_load_sysconfig(w, sysconfig) != 0 || ms_load_commands(w, commands) != 0) {
+        printf("%s\n", (w == NULL) ? "cannot allocate workload" : ms_workload_error(w));
+        exit(EXIT_FAILURE);
+    }
+    double  parse   = seconds_since(&start);
+    unlink(sysconfig);
+    unlink(commands);
+
+//  AND EXECUTE THEM
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    struct simulation *sim  = ms_new_simulation(w, NULL);
+
+    if(sim == NULL || ms_run(sim) != 0) {
+        printf("%s\n", (sim == NULL) ? "cannot allocate simulation" : ms_simulation_error(sim));
+        exit(EXIT_FAILURE);
+    }
+    double  run     = seconds_since(&start);
+
+    struct ms_stats stats;
+    struct rusage   usage;
+
+    ms_get_stats(sim, &stats);
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("{\"benchmark\":\"%s\",\"scale\":%i,\"command_bytes\":%lli,"
+           "\"parse_secs\":%.6f,\"parse_MB_per_sec\":%.1f,"
+           "\"simulated_usecs\":%lli,\"events\":%lli,\"run_secs\":%.6f,"
+           "\"simulated_usecs_per_sec\":%.0f,\"events_per_sec\":%.0f,\"peak_rss_KB\":%li}\n",
+           g->name, scale, (long long)st.st_size,
+           parse, (parse > 0) ? st.st_size / parse / 1e6 : 0.0,
+           stats.usecs, stats.nevents, run,
+           (run > 0) ? stats.usecs / run : 0.0, (run > 0) ? stats.nevents / run : 0.0,
+           usage.ru_maxrss);
+    ms_free_simulation(sim);
+    ms_free_workload(w);
+}
+
+//  RUN EACH BENCHMARK NAMED ON THE COMMAND-LINE, OR ALL OF THEM
+void benchmark(char argv0[], int nargs, char *args[])
+{
+    int     nall    = sizeof generators / sizeof generators[0] - 1;
+    int     n       = (nargs > 0) ? nargs : nall;
+
+    for(int b=0 ; b<n ; ++b) {
+        const struct generator  *g  = &generators[b];
+        int     scale               = g->scale;
+
+        if(nargs > 0 && (g = parse_generator(args[b], &scale)) == NULL) {
+            printf("%s: unknown benchmark or scale '%s'\n", argv0, args[b]);
+            exit(EXIT_FAILURE);
+        }
+        fflush(stdout);
+
+        pid_t   pid = fork();
+        int     status;
 
-    return total_time_on_CPU;
+        if(pid == 0) {
+            run_benchmark(argv0, g, scale);
+            exit(EXIT_SUCCESS);
+        }
+        if(pid < 0) {
+            run_benchmark(argv0, g, scale);
+        }
+        else if(waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
 }
 
 //  ----------------------------------------------------------------------
 
+//  RENDER A BINARY TRACE FILE, WRITTEN BY AN EARLIER --trace
+void decode(char argv0[], char filename[], int format)
+{
+    FILE    *fp = fopen(filename, "rb");
+
+    if(fp == NULL) {
+        printf("%s: cannot open '%s'\n", argv0, filename);
+        exit(EXIT_FAILURE);
+    }
+    if(ms_decode_trace(fp, stdout, format) != 0) {
+        if(ferror(stdout)) {
+            printf("%s: cannot write trace\n", argv0);
+        }
+        else {
+            printf("%s: '%s' is not a trace file\n", argv0, filename);
+        }
+        exit(EXIT_FAILURE);
+    }
+    fclose(fp);
+}
+
+//  REPORT THE WORKLOAD'S PROBLEMS, AND THE BOUNDS OF ITS MAKESPAN AND
+//  UTILIZATION, WITHOUT EXECUTING IT.  IT FAILS IF IT CANNOT FINISH.
+void analyze(struct workload *w)
+{
+    struct ms_analysis  analysis;
+
+    if(ms_analyze(w, NULL, stdout, &analysis) != 0) {
+        printf("%s\n", ms_workload_error(w));
+        exit(EXIT_FAILURE);
+    }
+    printf("processes  %lli\n", analysis.nprocesses);
+    printf("demand  %lli  %lli  %lli\n", analysis.time_on_CPU, analysis.bus_usecs, analysis.critical_path);
+    if(analysis.finishes) {
+        printf("bounds  %lli  %lli  %i  %i%s\n", analysis.makespan_lo, analysis.makespan_hi,
+                analysis.utilization_lo, analysis.utilization_hi,
+                analysis.approximate ? "  (approximate)" : "");
+    }
+    else {
+        printf("bounds  %lli  unbounded\n", analysis.makespan_lo);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void usage(char argv0[])
+{
+    printf("Usage: %s [--autotune [tunable=lo:hi[:step]]...] [--replications n] [--trace trace-file]\n", argv0);
+    printf("          [--metrics|--metrics-csv metrics-file] [--restore snapshot-file]\n");
+    printf("          [--snapshot-at usecs snapshot-file] [--arrivals arrivals-file|-]\n");
+    printf("          [--report-every usecs] [--telemetry|--telemetry-socket path]\n");
+    printf("          [--telemetry-every msecs] [--profile] sysconfig-file command-file\n");
+    printf("   or: %s --analyze sysconfig-file command-file\n", argv0);
+    printf("   or: %s --compile image-file sysconfig-file command-file\n", argv0);
+    printf("   or: %s --decode|--decode-json trace-file\n", argv0);
+    printf("   or: %s --benchmark [benchmark[:scale]]...\n", argv0);
+    printf("   or: %s --generate benchmark[:scale] sysconfig-file command-file\n", argv0);
+    exit(EXIT_FAILURE);
+}
+
 int main(int argc, char *argv[])
 {
+    bool tune           = false;
+    int  nreplicate     = 0;
+    char *trace_file    = NULL;
+    char *metrics_file  = NULL;
+    char *image_file    = NULL;
+    char *restore_file  = NULL;
+    char *snapshot_file = NULL;
+    usecs_t snapshot_at = 0;
+    char *arrivals_file = NULL;
+    usecs_t report_every= 0;
+    bool profile        = false;
+    bool analyzing      = false;
+    char *telemetry_path= NULL;
+    int  telemetry_kind = MS_TELEMETRY_FILE;
+    int  telemetry_every= DEFAULT_TELEMETRY_MSECS;
+    int  metrics_format = MS_METRICS_JSON;
+    int  a              = 1;
+
+//  A TRACE FILE MAY BE DECODED, AS TEXT OR AS A CHROME/PERFETTO JSON TRACE
+    if(argc == 3 && strcmp(argv[1], "--decode") == 0) {
+        decode(argv[0], argv[2], MS_TRACE_TEXT);
+        exit(EXIT_SUCCESS);
+    }
+    if(argc == 3 && strcmp(argv[1], "--decode-json") == 0) {
+        decode(argv[0], argv[2], MS_TRACE_JSON);
+        exit(EXIT_SUCCESS);
+    }
+
+//  MEASURE THE SIMULATOR ON SYNTHETIC WORKLOADS, OR WRITE ONE OF THEM
+    if(argc >= 2 && strcmp(argv[1], "--benchmark") == 0) {
+        benchmark(argv[0], argc-2, &argv[2]);
+        exit(EXIT_SUCCESS);
+    }
+    if(argc == 5 && strcmp(argv[1], "--generate") == 0) {
+        int                     scale;
+        const struct generator  *g  = parse_generator(argv[2], &scale);
+
+        if(g == NULL) {
+            usage(argv[0]);
+        }
+        if(!generate(g, scale, argv[3], argv[4])) {
+            printf("%s: cannot write '%s' or '%s'\n", argv[0], argv[3], argv[4]);
+            exit(EXIT_FAILURE);
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+//  AN OPTIONAL --autotune MAY BE FOLLOWED BY tunable=lo:hi[:step] RANGES
+    for( ; a < argc && strncmp(argv[a], "--", 2) == 0 ; ++a) {
+        if(strcmp(argv[a], "--autotune") == 0) {
+            tune    = true;
+            while(a+1 < argc && parse_tuning_range(argv[0], argv[a+1])) {
+                ++a;
+            }
+        }
+        else if(strcmp(argv[a], "--replications") == 0 && a+1 < argc) {
+            if((nreplicate = atoi(argv[++a])) < 1) {
+                usage(argv[0]);
+            }
+        }
+        else if(strcmp(argv[a], "--trace") == 0 && a+1 < argc) {
+            trace_file  = argv[++a];
+        }
+        else if(strcmp(argv[a], "--metrics") == 0 && a+1 < argc) {
+            metrics_file    = argv[++a];
+            metrics_format  = MS_METRICS_JSON;
+        }
+        else if(strcmp(argv[a], "--metrics-csv") == 0 && a+1 < argc) {
+            metrics_file    = argv[++a];
+            metrics_format  = MS_METRICS_CSV;
+        }
+        else if(strcmp(argv[a], "--compile") == 0 && a+1 < argc) {
+            image_file  = argv[++a];
+        }
+        else if(strcmp(argv[a], "--restore") == 0 && a+1 < argc) {
+            restore_file    = argv[++a];
+        }
+        else if(strcmp(argv[a], "--snapshot-at") == 0 && a+2 < argc) {
+            snapshot_at     = atoll(argv[++a]);
+            snapshot_file   = argv[++a];
+        }
+        else if(strcmp(argv[a], "--arrivals") == 0 && a+1 < argc) {
+            arrivals_file   = argv[++a];
+        }
+        else if(strcmp(argv[a], "--report-every") == 0 && a+1 < argc) {
+            if((report_every = atoll(argv[++a])) < 1) {
+                usage(argv[0]);
+            }
+        }
+        else if(strcmp(argv[a], "--profile") == 0) {
+#ifndef MYSCHEDULER_PROFILE
+            printf("%s: --profile requires compiling with -DMYSCHEDULER_PROFILE\n", argv[0]);
+            exit(EXIT_FAILURE);
+#endif
+            profile     = true;
+        }
+        else if(strcmp(argv[a], "--analyze") == 0) {
+            analyzing   = true;
+        }
+        else if(strcmp(argv[a], "--telemetry") == 0 && a+1 < argc) {
+            telemetry_path  = argv[++a];
+            telemetry_kind  = MS_TELEMETRY_FILE;
+        }
+        else if(strcmp(argv[a], "--telemetry-socket") == 0 && a+1 < argc) {
+            telemetry_path  = argv[++a];
+            telemetry_kind  = MS_TELEMETRY_SOCKET;
+        }
+        else if(strcmp(argv[a], "--telemetry-every") == 0 && a+1 < argc) {
+            if((telemetry_every = atoi(argv[++a])) < 1) {
+                usage(argv[0]);
+            }
+        }
+        else {
+            usage(argv[0]);
+        }
+    }
+
 //  ENSURE THAT WE HAVE THE CORRECT NUMBER OF COMMAND-LINE ARGUMENTS
-    if(argc != 3) {
-        printf("Usage: %s sysconfig-file command-file\n", argv[0]);
-        exit(EXIT_FAILURE);
+    if(argc - a != 2) {
+        usage(argv[0]);
     }
 
-    verbose = (getenv("VERBOSE") != NULL);      // debug printing required?
+//  VERBOSE PRINTS THE TRACE AS TEXT, --trace WRITES IT IN BINARY
+    FILE *trace         = (getenv("VERBOSE") != NULL) ? stdout : NULL;
+    int  trace_format   = MS_TRACE_TEXT;
 
-//  READ THE SYSTEM CONFIGURATION FILE
-    read_sysconfig(argv[0], argv[1]);
-//  NOT REQUIRED, BUT PROVIDES A CHECK THAT THINGS HAVE BEEN STORED CORRECTLY
-//  dump_sysconfig();
+    if(trace_file != NULL) {
+        if((trace = fopen(trace_file, "wb")) == NULL) {
+            printf("%s: cannot create '%s'\n", argv[0], trace_file);
+            exit(EXIT_FAILURE);
+        }
+        trace_format    = MS_TRACE_BINARY;
+    }
 
-//  READ THE COMMAND FILE
-    read_commands(argv[0], argv[2]);
+//  READ THE SYSTEM CONFIGURATION FILE, THEN THE COMMAND FILE
+    struct workload *w  = ms_new_workload((trace_format == MS_TRACE_TEXT) ? trace : NULL);
+
+    if(w == NULL) {
+        printf("%s: cannot allocate workload\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if(ms_load_sysconfig(w, argv[a]) != 0 || ms_load_commands(w, argv[a+1]) != 0) {
+        printf("%s\n", ms_workload_error(w));
+        exit(EXIT_FAILURE);
+    }
 //  NOT REQUIRED, BUT PROVIDES A CHECK THAT THINGS HAVE BEEN STORED CORRECTLY
-//  dump_commands();
+//  dump_sysconfig(w);
+//  dump_commands(w);
+
+//  COMPILE THE COMMANDS TO AN IMAGE, TO BE LOADED INSTEAD OF THE command-file
+    if(image_file != NULL) {
+        if(ms_write_image(w, image_file) != 0) {
+            printf("%s\n", ms_workload_error(w));
+            exit(EXIT_FAILURE);
+        }
+        ms_free_workload(w);
+        exit(EXIT_SUCCESS);
+    }
+
+//  ANALYZE THE WORKLOAD, INSTEAD OF EXECUTING IT
+    if(analyzing) {
+        analyze(w);
+        ms_free_workload(w);
+        exit(EXIT_SUCCESS);
+    }
+
+//  SEARCH FOR THE BEST CONFIGURATIONS, INSTEAD OF EXECUTING JUST ONE
+    if(tune) {
+        autotune(argv[0], w);
+        exit(EXIT_SUCCESS);
+    }
 
-    init_processes();
-    init_READY_queue();
-    init_SLEEPING_queue();
-    init_WAITING_queue();
-    init_devices_and_IO_BLOCKED_queues();
+//  OR REPLICATE A STOCHASTIC WORKLOAD, REPORTING THE DISTRIBUTION OF ITS RESULTS
+    if(nreplicate > 0) {
+        replicate(argv[0], w, nreplicate);
+        exit(EXIT_SUCCESS);
+    }
 
 //  EXECUTE COMMANDS, STARTING AT FIRST IN command-file, UNTIL NONE REMAIN
-    int total_time_on_CPU   = execute_commands(0);  // first spawn commands[0]
+    struct ms_config config;
+
+    ms_default_config(w, &config);
+    config.trace        = trace;
+    config.trace_format = trace_format;
+
+    struct simulation *sim  = ms_new_simulation(w, &config);
+
+    if(sim == NULL) {
+        printf("%s: cannot allocate simulation\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+//  PUBLISH THE SIMULATION'S PROGRESS, WHILE IT EXECUTES
+    if(telemetry_path != NULL &&
+       ms_set_telemetry(sim, telemetry_path, telemetry_kind, telemetry_every) != 0) {
+        printf("%s\n", ms_simulation_error(sim));
+        exit(EXIT_FAILURE);
+    }
+
+//  IN AN OPEN SYSTEM, PROCESSES ARRIVE FROM A FILE, FIFO, OR stdin
+    FILE    *arrivals   = NULL;
+
+    if(arrivals_file != NULL) {
+        arrivals    = (strcmp(arrivals_file, "-") == 0) ? stdin : fopen(arrivals_file, "r");
+        if(arrivals == NULL) {
+            printf("%s: cannot open '%s'\n", argv[0], arrivals_file);
+            exit(EXIT_FAILURE);
+        }
+        if(ms_set_arrivals(sim, arrivals) != 0) {
+            printf("%s\n", ms_simulation_error(sim));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+//  CONTINUE FROM A SNAPSHOT, INSTEAD OF FROM REBOOTING
+    if(restore_file != NULL) {
+        FILE    *fp = fopen(restore_file, "rb");
+
+        if(fp == NULL) {
+            printf("%s: cannot open '%s'\n", argv[0], restore_file);
+            exit(EXIT_FAILURE);
+        }
+        if(ms_restore_snapshot(sim, fp) != 0) {
+            printf("%s\n", ms_simulation_error(sim));
+            exit(EXIT_FAILURE);
+        }
+        fclose(fp);
+    }
+
+//  SAVE A SNAPSHOT AT THE FIRST EVENT BOUNDARY AT OR AFTER snapshot_at usecs
+    if(snapshot_file != NULL) {
+        struct ms_stats stats;
+        FILE    *fp;
+
+        do {
+            if(ms_step(sim, 1) < 0) {
+                printf("%s\n", ms_simulation_error(sim));
+                exit(EXIT_FAILURE);
+            }
+            ms_get_stats(sim, &stats);
+        } while(!stats.finished && stats.usecs < snapshot_at);
+
+        if((fp = fopen(snapshot_file, "wb")) == NULL || ms_save_snapshot(sim, fp) != 0 || fclose(fp) != 0) {
+            printf("%s: cannot write '%s'\n", argv[0], snapshot_file);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(report_every > 0) {
+        report_windows(sim, report_every);
+    }
+    if(ms_run(sim) != 0) {
+        printf("%s\n", ms_simulation_error(sim));
+        exit(EXIT_FAILURE);
+    }
 
 //  PRINT THE PROGRAM'S RESULTS
-    DEBUG("%iusecs total system time, %iusecs onCPU by all processes, %i/%i -> %i%%",
-            USECS_SINCE_REBOOT, total_time_on_CPU,
-            total_time_on_CPU, USECS_SINCE_REBOOT,
-            100*total_time_on_CPU / USECS_SINCE_REBOOT);
-    flush_DEBUG(UNKNOWN);
+    struct ms_stats stats;
+
+    ms_get_stats(sim, &stats);
+
+    printf("measurements  %lli  %i\n", stats.usecs, stats.utilization);
 
-    printf("measurements  %i  %i\n", USECS_SINCE_REBOOT, 100*total_time_on_CPU / USECS_SINCE_REBOOT);
+//  WITH COALESCING, REPORT HOW MANY I/O REQUESTS (OF ALL) DID NOT ACQUIRE
+//  THE DATABUS, AND THE usecs OF BUS OVERHEAD THAT SAVED
+    if(config.coalesce_count > 0 || config.coalesce_bytes > 0) {
+        printf("coalesced  %lli  %lli  %lli\n", stats.ncoalesced, stats.ntransfers, stats.bus_usecs_saved);
+    }
+
+//  WITH MULTIPLE CORES, REPORT EACH CORE'S usecs COMPUTING, ITS UTILIZATION,
+//  ITS NUMBER OF CONTEXT SWITCHES (AND usecs SPENT IN THEM), AND ITS STEALS
+    if(stats.ncores > 1) {
+        for(int k=0 ; k<stats.ncores ; ++k) {
+            struct ms_core_stats core;
+
+            ms_get_core_stats(sim, k, &core);
+            printf("core%i  %lli  %i  %i  %lli  %i\n", k,
+                    core.time_on_CPU, core.utilization,
+                    core.ncontext_switches, core.time_switching, core.nsteals);
+        }
+    }
+
+//  WRITE THE LATENCIES OF ALL PROCESSES AND DEVICES, AS JSON OR CSV
+    if(metrics_file != NULL) {
+        FILE    *fp = fopen(metrics_file, "w");
+
+        if(fp == NULL || ms_write_metrics(sim, fp, metrics_format) != 0 || fclose(fp) != 0) {
+            printf("%s: cannot write '%s'\n", argv[0], metrics_file);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+//  REPORT WHERE THE SIMULATOR ITSELF SPENT ITS TIME
+    if(profile && ms_write_profile(sim, stdout) != 0) {
+        printf("%s\n", ms_simulation_error(sim));
+        exit(EXIT_FAILURE);
+    }
 
+    ms_free_simulation(sim);
+    ms_free_workload(w);
+    if(trace_file != NULL) {
+        fclose(trace);
+    }
+    if(arrivals != NULL && arrivals != stdin) {
+        fclose(arrivals);
+    }
     exit(EXIT_SUCCESS);
 }
 
-//  vim: ts=8 sw=4
\ No newline at end of file
+#endif  // MYSCHEDULER_LIBRARY
+
+//  vim: ts=8 sw=4
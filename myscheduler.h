@@ -0,0 +1,179 @@
+#ifndef MYSCHEDULER_H
+#define MYSCHEDULER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+//  THE SCHEDULER MAY BE EMBEDDED IN OTHER PROGRAMS, BY COMPILING myscheduler.c
+//  WITH -DMYSCHEDULER_LIBRARY (WHICH OMITS ITS main()) AND CALLING THESE FUNCTIONS.
+//
+//  A workload HOLDS THE DEVICES AND COMMANDS READ FROM A sysconfig AND A
+//  command FILE.  ms_write_image() COMPILES ITS COMMANDS TO A BINARY IMAGE,
+//  WHICH ms_load_commands() THEN ACCEPTS IN PLACE OF THE command FILE.
+//  ONCE LOADED IT IS NEVER MODIFIED, SO ANY NUMBER OF simulations, IN ANY
+//  NUMBER OF THREADS, MAY SHARE IT.  A simulation HOLDS ALL STATE OF ONE
+//  EXECUTION OF A workload, AND IS USED BY ONE THREAD AT A TIME.
+//
+//  FUNCTIONS RETURNING int RETURN 0 ON SUCCESS, AND -1 ON ERROR (THEN
+//  DESCRIBED BY ms_workload_error() OR ms_simulation_error()).
+
+//  ALL TIMES ARE MEASURED IN MICROSECONDS (usecs)
+typedef long long               usecs_t;
+
+struct workload;
+struct simulation;
+
+//  A TRACE IS WRITTEN AS TEXT, AS A CHROME/PERFETTO JSON TRACE, OR AS
+//  COMPACT BINARY RECORDS (LATER RENDERED AS EITHER BY ms_decode_trace())
+#define MS_TRACE_TEXT           0
+#define MS_TRACE_JSON           1
+#define MS_TRACE_BINARY         2
+
+//  THE PARAMETERS OF A simulation, WHOSE DEFAULTS ARE READ FROM sysconfig
+struct ms_config {
+    usecs_t     timequantum;
+    int         ncores;
+    int         steal_policy;           // 0=none, 1=busiest, 2=neighbour
+    usecs_t     time_steal;
+    int         scheduler;              // 0=rr, 1=mlfq, 2=cfs, 3=sjf, 4=priority
+    int         nbuses;                 // #databuses, or DMA channels
+    int         arbitration;            // 0=fastest, 1=fifo, 2=deadline
+    int         coalesce_count;         // max requests per bus acquisition, 0=unlimited
+    long long   coalesce_bytes;         // max bytes per bus acquisition, 0=unlimited
+                                        // (both 0 => no coalescing)
+    unsigned long long  seed;           // of the random values of stochastic commands
+    FILE        *trace;                 // trace output, or NULL
+    int         trace_format;           // MS_TRACE_TEXT ...
+};
+
+struct ms_stats {
+    usecs_t     usecs;                  // since reboot, the makespan once finished
+    usecs_t     time_on_CPU;            // by all processes that have exited
+    int         utilization;            // percentage, over all cores
+    int         nprocesses;             // #processes still running
+    long long   nspawned;               // #processes ever spawned
+    long long   narrived;               // #processes without a parent
+    long long   nevents;                // #events executed
+    int         ncores;
+    bool        finished;
+    long long   ntransfers;             // #I/O requests transferred (or transferring)
+    long long   ncoalesced;             // #of those that did not acquire the databus
+    usecs_t     bus_usecs_saved;        // by not acquiring it
+};
+
+//  THE LATENCIES OF ALL EXITED PROCESSES, AND OF EACH DEVICE'S I/O, ARE
+//  AGGREGATED IN LOG-BUCKETED HISTOGRAMS, WHOSE SIZE IS FIXED HOWEVER MANY
+//  PROCESSES EXECUTE.  THEIR PERCENTILES ARE WITHIN 1/32 OF THE TRUE VALUES.
+#define MS_METRIC_TURNAROUND    0       // from spawn to exit
+#define MS_METRIC_RESPONSE      1       // from spawn to first on a CPU
+#define MS_METRIC_SCHEDULING    2       // each wait in a READY queue
+#define MS_METRIC_READY         3       // total usecs READY, per process
+#define MS_METRIC_BLOCKED       4       // total usecs BLOCKED on I/O, per process
+#define MS_METRIC_SLEEPING      5       // total usecs SLEEPING, per process
+#define MS_METRIC_WAITING       6       // total usecs WAITING, per process
+#define MS_NMETRICS             7
+
+#define MS_DEVICE_BUS_WAIT      0       // each I/O's wait for the databus
+#define MS_DEVICE_TRANSFER      1       // each I/O's use of the databus
+#define MS_NDEVICE_METRICS      2
+
+#define MS_METRICS_JSON         0
+#define MS_METRICS_CSV          1
+
+struct ms_latency {
+    long long   count;
+    usecs_t     min, max;
+    usecs_t     total;
+    usecs_t     p50, p90, p99;
+};
+
+struct ms_core_stats {
+    usecs_t     time_on_CPU;            // usecs spent computing
+    usecs_t     time_switching;         // usecs spent context switching
+    int         utilization;            // percentage
+    int         ncontext_switches;
+    int         nsteals;
+};
+
+extern struct workload  *ms_new_workload(FILE *warnings);
+extern int          ms_load_sysconfig(struct workload *w, const char filename[]);
+extern int          ms_load_commands(struct workload *w, const char filename[]);
+extern int          ms_write_image(struct workload *w, const char filename[]);
+extern void         ms_default_config(const struct workload *w, struct ms_config *config);
+extern const char   *ms_workload_error(const struct workload *w);
+extern void         ms_free_workload(struct workload *w);
+
+//  A workload MAY BE ANALYZED WITHOUT EXECUTING IT, FOR A GIVEN (OR NULL)
+//  config.  ms_analyze() DESCRIBES EACH PROBLEM FOUND (A COMMAND THAT SPAWNS
+//  ITSELF, A wait THAT CAN NEVER RETURN, A COMMAND THAT NEVER EXITS, OR A
+//  SYSCALL THAT CANNOT EXECUTE AS WRITTEN) AS A LINE OF report (IF NOT NULL),
+//  AND BOUNDS THE MAKESPAN AND UTILIZATION OF EXECUTING THE FIRST COMMAND.
+//  VALUES DRAWN FROM DISTRIBUTIONS ARE TAKEN TO BE THEIR MEANS.
+struct ms_analysis {
+    int         nproblems;
+    bool        finishes;               // false => makespan_hi is -1
+    bool        approximate;            // some values are drawn
+    long long   nprocesses;             // #processes ever spawned
+    usecs_t     time_on_CPU;            // by all processes
+    usecs_t     bus_usecs;              // of the busiest databus
+    usecs_t     critical_path;          // the longest chain of processes' steps
+    usecs_t     makespan_lo, makespan_hi;
+    int         utilization_lo, utilization_hi;
+};
+
+extern int          ms_analyze(struct workload *w, const struct ms_config *config, FILE *report,
+                               struct ms_analysis *analysis);
+
+//  A NULL config USES THE DEFAULTS.  THE FIRST COMMAND IS EXECUTED, UNTIL
+//  ALL PROCESSES HAVE EXITED, EITHER BY ms_run() OR BY REPEATED ms_step(),
+//  WHICH EXECUTES UP TO nevents EVENTS AND RETURNS HOW MANY IT EXECUTED.
+extern struct simulation *ms_new_simulation(const struct workload *w, const struct ms_config *config);
+extern long long    ms_step(struct simulation *sim, long long nevents);
+extern int          ms_run(struct simulation *sim);
+
+//  IN AN OPEN SYSTEM, SET BEFORE ITS FIRST ms_step(), PROCESSES ARRIVE AS LINES
+//  OF "usecs command" READ FROM fp (SUCH AS stdin OR A FIFO) ONE AT A TIME, AS
+//  THE SIMULATED TIME REACHES THEM, RATHER THAN THE FIRST COMMAND BEING
+//  SPAWNED AT REBOOT.  IT FINISHES ONCE fp IS EXHAUSTED AND ALL HAVE EXITED,
+//  AND CANNOT BE SAVED, RESTORED, OR FORKED.
+extern int          ms_set_arrivals(struct simulation *sim, FILE *fp);
+extern void         ms_get_stats(const struct simulation *sim, struct ms_stats *stats);
+extern int          ms_get_core_stats(const struct simulation *sim, int core, struct ms_core_stats *stats);
+extern int          ms_get_latency(const struct simulation *sim, int metric, struct ms_latency *latency);
+extern int          ms_get_device_latency(const struct simulation *sim, int device, int metric,
+                                          struct ms_latency *latency);
+extern int          ms_write_metrics(const struct simulation *sim, FILE *fp, int format);
+
+//  WHILE IT EXECUTES, A simulation MAY PUBLISH ITS PROGRESS (ITS CLOCK AND
+//  RATE, ITS PROCESSES AND QUEUES, AND ITS DATABUSES) EVERY interval_msecs
+//  OF REAL TIME, IN PROMETHEUS' TEXT FORMAT, FROM A BACKGROUND THREAD THAT IT
+//  NEVER WAITS FOR.  EACH SAMPLE EITHER REPLACES THE FILE path, OR IS SERVED
+//  TO EACH CLIENT OF THE UNIX-DOMAIN SOCKET path (AS HTTP, TO A GET REQUEST).
+//  THE FINAL SAMPLE IS PUBLISHED BEFORE ms_free_simulation() RETURNS.
+#define MS_TELEMETRY_FILE       0
+#define MS_TELEMETRY_SOCKET     1
+
+extern int          ms_set_telemetry(struct simulation *sim, const char path[], int kind,
+                                     int interval_msecs);
+
+//  COMPILED WITH -DMYSCHEDULER_PROFILE, THE SCHEDULER PROFILES ITSELF, AND
+//  ms_write_profile() REPORTS THE CALLS, ELEMENTS, AND CPU TIME OF EACH PHASE
+//  OF LOADING AND EXECUTING (AND ANY AVAILABLE HARDWARE COUNTERS) AS TEXT.
+//  OTHERWISE, NOTHING IS MEASURED, AND IT FAILS.
+extern int          ms_write_profile(struct simulation *sim, FILE *fp);
+
+//  BETWEEN CALLS TO ms_step(), A STARTED simulation MAY BE SAVED TO A SNAPSHOT,
+//  LATER RESTORED INTO A NEW simulation OF THE SAME workload, OR FORKED INTO A
+//  NEW simulation (WHICH IS NULL ON FAILURE).  THE NUMBER OF cores AND buses,
+//  THE scheduler, AND THE arbitration ARE PART OF THE STATE; THE OTHER FIELDS
+//  OF ms_config ARE THOSE OF THE CONTINUATION, OR (IF NULL) OF THE ORIGINAL.
+extern int          ms_save_snapshot(struct simulation *sim, FILE *fp);
+extern int          ms_restore_snapshot(struct simulation *sim, FILE *fp);
+extern struct simulation *ms_fork_simulation(const struct simulation *sim, const struct ms_config *config);
+
+extern const char   *ms_simulation_error(const struct simulation *sim);
+extern void         ms_free_simulation(struct simulation *sim);
+
+extern int          ms_decode_trace(FILE *binary, FILE *out, int format);
+
+#endif